@@ -23,9 +23,15 @@ def _load_lib():
     lib.az_legal_moves.argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.POINTER(ctypes.c_uint64)]
     lib.az_legal_moves.restype = ctypes.c_int
 
+    lib.az_legal_mask.argtypes = [ctypes.c_uint64, ctypes.c_uint64]
+    lib.az_legal_mask.restype = ctypes.c_uint64
+
     lib.az_result.argtypes = [ctypes.c_uint64, ctypes.c_uint64]
     lib.az_result.restype = ctypes.c_char
 
+    lib.az_winning_moves.argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_char]
+    lib.az_winning_moves.restype = ctypes.c_uint64
+
     lib.az_apply_move.argtypes = [
         ctypes.c_uint64,
         ctypes.c_uint64,
@@ -42,6 +48,72 @@ def _load_lib():
     lib.az_move_bit.argtypes = [ctypes.c_int]
     lib.az_move_bit.restype = ctypes.c_uint64
 
+    ptr = ctypes.c_void_p
+    lib.az_legal_mask_batch.argtypes = [ctypes.c_int, ptr, ptr, ptr]
+    lib.az_legal_mask_batch.restype = None
+
+    lib.az_result_batch.argtypes = [ctypes.c_int, ptr, ptr, ptr]
+    lib.az_result_batch.restype = None
+
+    lib.az_apply_move_batch.argtypes = [ctypes.c_int, ptr, ptr, ptr, ptr, ptr, ptr]
+    lib.az_apply_move_batch.restype = None
+
+    lib.az_encode_batch.argtypes = [ctypes.c_int, ptr, ptr, ptr, ptr, ctypes.c_int]
+    lib.az_encode_batch.restype = None
+
+    lib.az_encode_batch_u8.argtypes = [ctypes.c_int, ptr, ptr, ptr, ptr, ctypes.c_int]
+    lib.az_encode_batch_u8.restype = None
+
+    lib.az_sym_board.argtypes = [ctypes.c_uint64, ctypes.c_int]
+    lib.az_sym_board.restype = ctypes.c_uint64
+    lib.az_sym_move.argtypes = [ctypes.c_int, ctypes.c_int]
+    lib.az_sym_move.restype = ctypes.c_int
+    lib.az_sym_inverse.argtypes = [ctypes.c_int]
+    lib.az_sym_inverse.restype = ctypes.c_int
+    lib.az_canonicalize.argtypes = [
+        ctypes.c_uint64,
+        ctypes.c_uint64,
+        ctypes.POINTER(ctypes.c_uint64),
+        ctypes.POINTER(ctypes.c_uint64),
+    ]
+    lib.az_canonicalize.restype = ctypes.c_int
+    lib.az_canonicalize_batch.argtypes = [ctypes.c_int, ptr, ptr, ptr, ptr, ptr]
+    lib.az_canonicalize_batch.restype = None
+
+    lib.az_perft.argtypes = [
+        ctypes.c_uint64,
+        ctypes.c_uint64,
+        ctypes.c_char,
+        ctypes.c_int,
+        ctypes.c_int,
+        ctypes.c_int,
+        ctypes.POINTER(ctypes.c_int64),
+    ]
+    lib.az_perft.restype = ctypes.c_int64
+
+    lib.az_puct_new.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_float]
+    lib.az_puct_new.restype = ptr
+    lib.az_puct_free.argtypes = [ptr]
+    lib.az_puct_free.restype = None
+    lib.az_puct_set_root.argtypes = [ptr, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_char]
+    lib.az_puct_set_root.restype = ctypes.c_int
+    lib.az_puct_reset.argtypes = [ptr, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_char]
+    lib.az_puct_reset.restype = None
+    lib.az_puct_advance.argtypes = [ptr, ctypes.c_int]
+    lib.az_puct_advance.restype = ctypes.c_int
+    lib.az_puct_select.argtypes = [ptr, ctypes.c_int, ctypes.c_int, ptr, ctypes.POINTER(ctypes.c_int32)]
+    lib.az_puct_select.restype = ctypes.c_int
+    lib.az_puct_backup.argtypes = [ptr, ptr, ptr]
+    lib.az_puct_backup.restype = None
+    lib.az_puct_root_children.argtypes = [ptr, ptr, ptr]
+    lib.az_puct_root_children.restype = ctypes.c_int
+    lib.az_puct_add_root_noise.argtypes = [ptr, ptr, ctypes.c_float]
+    lib.az_puct_add_root_noise.restype = None
+    lib.az_puct_policy.argtypes = [ptr, ctypes.c_float, ptr]
+    lib.az_puct_policy.restype = None
+    lib.az_puct_stats.argtypes = [ptr, ptr]
+    lib.az_puct_stats.restype = None
+
     lib.az_init()
     return lib
 
@@ -49,6 +121,47 @@ def _load_lib():
 _LIB = _load_lib()
 
 
+def _buf(arr, dtype, n):
+    """Raw pointer to a contiguous torch tensor or NumPy array of `dtype` (no copy).
+
+    The C side reads or writes `n` elements, so shorter buffers are rejected. NumPy
+    arrays may use either signedness of an integer `dtype` (e.g. uint64 bitboards).
+    """
+    if isinstance(arr, torch.Tensor):
+        if arr.dtype != dtype or not arr.is_contiguous() or arr.device.type != "cpu":
+            raise ValueError(f"expected a contiguous CPU {dtype} tensor")
+        size, ptr = arr.numel(), arr.data_ptr()
+    else:
+        kinds = "f" if dtype.is_floating_point else "iu"
+        if (
+            arr.dtype.kind not in kinds
+            or arr.dtype.itemsize != torch.empty((), dtype=dtype).element_size()
+            or not arr.flags["C_CONTIGUOUS"]
+        ):
+            raise ValueError(f"expected a C-contiguous array matching {dtype}, got {arr.dtype}")
+        size, ptr = arr.size, arr.ctypes.data
+    if size < n:
+        raise ValueError(f"expected at least {n} elements, got {size}")
+    return ctypes.c_void_p(ptr)
+
+
+# Board symmetries that respect gravity (see az_canonicalize in engine.h).
+SYM_COUNT = 8
+# SYM_MOVES[t][i]: cell index i under transform t.
+SYM_MOVES = [[_LIB.az_sym_move(i, t) for i in range(64)] for t in range(SYM_COUNT)]
+SYM_INVERSE = [_LIB.az_sym_inverse(t) for t in range(SYM_COUNT)]
+
+
+def _mask_indices(mask: int):
+    # Walk the mask from the top bit so indices come out ascending.
+    out = []
+    while mask:
+        top = mask.bit_length() - 1
+        out.append(63 - top)
+        mask ^= 1 << top
+    return out
+
+
 @dataclass(frozen=True)
 class GameState:
     black: int
@@ -65,9 +178,16 @@ class Engine:
         n = self._lib.az_legal_moves(state.black, state.white, arr)
         return [arr[i] for i in range(n)]
 
+    def legal_mask(self, state: GameState):
+        return int(self._lib.az_legal_mask(state.black, state.white))
+
     def legal_moves_indices(self, state: GameState):
-        moves = self.legal_moves_bits(state)
-        return [int(self._lib.az_move_index(mv)) for mv in moves]
+        return _mask_indices(self.legal_mask(state))
+
+    def winning_moves(self, state: GameState):
+        """Legal moves (ascending indices) that win immediately for state.turn."""
+        mask = self._lib.az_winning_moves(state.black, state.white, ctypes.c_char(state.turn.encode("ascii")))
+        return _mask_indices(int(mask))
 
     def apply_move(self, state: GameState, move):
         if isinstance(move, int) and 0 <= move < 64:
@@ -92,39 +212,188 @@ class Engine:
     def move_index(self, bit: int):
         return int(self._lib.az_move_index(bit))
 
+    def transform(self, state: GameState, t: int):
+        return GameState(int(self._lib.az_sym_board(state.black, t)), int(self._lib.az_sym_board(state.white, t)), state.turn)
+
+    def canonicalize(self, state: GameState):
+        """(canonical state, t) with canonical == transform(state, t); symmetric states share it."""
+        black = ctypes.c_uint64()
+        white = ctypes.c_uint64()
+        t = self._lib.az_canonicalize(state.black, state.white, ctypes.byref(black), ctypes.byref(white))
+        return GameState(int(black.value), int(white.value), state.turn), int(t)
+
+    def canonicalize_batch(self, black, white, out_black=None, out_white=None, out_transforms=None):
+        n = len(black)
+        if out_black is None:
+            out_black = torch.empty(n, dtype=torch.int64)
+        if out_white is None:
+            out_white = torch.empty(n, dtype=torch.int64)
+        if out_transforms is None:
+            out_transforms = torch.empty(n, dtype=torch.uint8)
+        self._lib.az_canonicalize_batch(
+            n,
+            _buf(black, torch.int64, n),
+            _buf(white, torch.int64, n),
+            _buf(out_black, torch.int64, n),
+            _buf(out_white, torch.int64, n),
+            _buf(out_transforms, torch.uint8, n),
+        )
+        return out_black, out_white, out_transforms
 
-def encode_state(state: GameState):
-    planes = torch.zeros((2, 4, 4, 4), dtype=torch.float32)
-    if state.turn == "b":
-        cur = state.black
-        opp = state.white
-    else:
-        cur = state.white
-        opp = state.black
-
-    _fill_plane(planes[0], cur)
-    _fill_plane(planes[1], opp)
-    return planes
-
+    def perft(self, state: GameState, depth: int, bulk=True, threads=0):
+        """Counts positions `depth` plies ahead: {leaves, wins, draws, nodes} (see az_perft)."""
+        out = (ctypes.c_int64 * 4)()
+        self._lib.az_perft(
+            state.black, state.white, ctypes.c_char(state.turn.encode("ascii")), depth, int(bulk), threads, out
+        )
+        return {"leaves": out[0], "wins": out[1], "draws": out[2], "nodes": out[3]}
+
+    # Batched calls over N positions. Bitboards are int64 tensors (or uint64/int64
+    # NumPy arrays) holding the raw 64-bit patterns; turns and results are uint8
+    # ASCII codes (ord("b"), ord("w"), ...); moves are int32 indices. Outputs are
+    # allocated when not given and may be the input buffers themselves.
+
+    def legal_mask_batch(self, black, white, out=None):
+        n = len(black)
+        if out is None:
+            out = torch.empty(n, dtype=torch.int64)
+        self._lib.az_legal_mask_batch(
+            n, _buf(black, torch.int64, n), _buf(white, torch.int64, n), _buf(out, torch.int64, n)
+        )
+        return out
+
+    def result_batch(self, black, white, out=None):
+        n = len(black)
+        if out is None:
+            out = torch.empty(n, dtype=torch.uint8)
+        self._lib.az_result_batch(
+            n, _buf(black, torch.int64, n), _buf(white, torch.int64, n), _buf(out, torch.uint8, n)
+        )
+        return out
+
+    def apply_move_batch(self, black, white, turns, moves, out_black=None, out_white=None):
+        n = len(black)
+        if out_black is None:
+            out_black = torch.empty(n, dtype=torch.int64)
+        if out_white is None:
+            out_white = torch.empty(n, dtype=torch.int64)
+        self._lib.az_apply_move_batch(
+            n,
+            _buf(black, torch.int64, n),
+            _buf(white, torch.int64, n),
+            _buf(turns, torch.uint8, n),
+            _buf(moves, torch.int32, n),
+            _buf(out_black, torch.int64, n),
+            _buf(out_white, torch.int64, n),
+        )
+        return out_black, out_white
 
-def _build_layer_lut():
-    lut = torch.zeros((1 << 16, 4, 4), dtype=torch.float32)
-    bits = torch.arange(1 << 16, dtype=torch.int32)
-    for i in range(16):
-        y = i // 4
-        x = i % 4
-        lut[:, y, x] = ((bits >> (15 - i)) & 1).float()
-    return lut
 
+class PuctTree:
+    """Handle to a native PUCT tree (az_puct_*); see engine.h for the select/backup loop."""
 
-_LAYER_LUT = _build_layer_lut()
+    def __init__(self, max_nodes=1 << 20, cache_entries=1 << 16, c_puct=1.5):
+        self._lib = _LIB
+        self._max_nodes = max_nodes
+        self._ptr = self._lib.az_puct_new(max_nodes, cache_entries, c_puct)
+        if not self._ptr:
+            raise MemoryError("az_puct_new failed")
+        self._leaves = 0           # leaves returned by the last select(), owed a backup()
+
+    def __del__(self):
+        ptr = getattr(self, "_ptr", None)
+        if ptr:
+            self._lib.az_puct_free(ptr)
+            self._ptr = None
+
+    def set_root(self, state: GameState):
+        return bool(self._lib.az_puct_set_root(self._ptr, state.black, state.white, state.turn.encode("ascii")))
+
+    def set_root_with_room(self, state: GameState, free_nodes: int):
+        """Like set_root(), but drops a kept tree that leaves fewer than `free_nodes` nodes free."""
+        if self.set_root(state) and self.stats()[2] > self._max_nodes - free_nodes:
+            self._lib.az_puct_reset(self._ptr, state.black, state.white, state.turn.encode("ascii"))
+            return False
+        return True
+
+    def advance(self, action: int):
+        return bool(self._lib.az_puct_advance(self._ptr, int(action)))
+
+    def select(self, inputs, max_leaves, max_sims):
+        """Writes up to `max_leaves` encoded leaves into `inputs`; returns (leaves, sims done)."""
+        done = ctypes.c_int32()
+        inputs_ptr = _buf(inputs, torch.float32, max_leaves * 128)
+        n = self._lib.az_puct_select(self._ptr, max_leaves, max_sims, inputs_ptr, ctypes.byref(done))
+        self._leaves = n
+        return n, int(done.value)
+
+    def backup(self, logits, values):
+        """Backs up the evaluations of the last select(): `leaves` x 64 logits and `leaves` values."""
+        logits_ptr = _buf(logits, torch.float32, self._leaves * 64)
+        values_ptr = _buf(values, torch.float32, self._leaves)
+        self._lib.az_puct_backup(self._ptr, logits_ptr, values_ptr)
+        self._leaves = 0
+
+    def root_children(self):
+        moves = (ctypes.c_int32 * 16)()
+        visits = (ctypes.c_int32 * 16)()
+        n = self._lib.az_puct_root_children(self._ptr, moves, visits)
+        return list(moves[:n]), list(visits[:n])
+
+    def add_root_noise(self, noise, eps):
+        buf = (ctypes.c_float * len(noise))(*[float(x) for x in noise])
+        self._lib.az_puct_add_root_noise(self._ptr, buf, eps)
+
+    def policy(self, temperature, out):
+        self._lib.az_puct_policy(self._ptr, temperature, _buf(out, torch.float32, 64))
+        return out
+
+    def stats(self):
+        out = (ctypes.c_int64 * 3)()
+        self._lib.az_puct_stats(self._ptr, out)
+        return int(out[0]), int(out[1]), int(out[2])
+
+
+def _to_i64(bits: int):
+    return bits - (1 << 64) if bits >= 1 << 63 else bits
 
 
-def _fill_plane(plane, board_bits: int):
-    for layer in range(4):
-        shift = 48 - layer * 16
-        chunk = (board_bits >> shift) & 0xFFFF
-        plane[layer] = _LAYER_LUT[chunk]
+def encode_state(state: GameState):
+    return encode_states([state])[0]
+
+
+def encode_states(states, dtype=torch.float32, threads=0):
+    """(N, 2, 4, 4, 4) network input for `states` in one native call.
+
+    Plane 0 is the side to move, plane 1 the opponent. `dtype` is torch.float32
+    or torch.uint8; `threads <= 0` lets the engine use all CPUs for large batches.
+    """
+    black = torch.tensor([_to_i64(s.black) for s in states], dtype=torch.int64)
+    white = torch.tensor([_to_i64(s.white) for s in states], dtype=torch.int64)
+    turns = torch.tensor([ord(s.turn) for s in states], dtype=torch.uint8)
+    return encode_batch(black, white, turns, dtype=dtype, threads=threads)
+
+
+def encode_batch(black, white, turns, out=None, dtype=torch.float32, threads=0):
+    """Like encode_states() but from int64/uint8 buffers; fills `out` in place when given."""
+    n = len(black)
+    if out is None:
+        out = torch.empty((n, 2, 4, 4, 4), dtype=dtype)
+    if out.dtype == torch.float32:
+        fn = _LIB.az_encode_batch
+    elif out.dtype == torch.uint8:
+        fn = _LIB.az_encode_batch_u8
+    else:
+        raise ValueError(f"unsupported encoding dtype: {out.dtype}")
+    fn(
+        n,
+        _buf(black, torch.int64, n),
+        _buf(white, torch.int64, n),
+        _buf(turns, torch.uint8, n),
+        _buf(out, out.dtype, n * 128),
+        threads,
+    )
+    return out
 
 
 def render_board(state: GameState):
@@ -2,6 +2,7 @@ import argparse
 import multiprocessing as mp
 import os
 import random
+import time
 from pathlib import Path
 
 import numpy as np
@@ -9,8 +10,8 @@ import torch
 import torch.nn.functional as F
 from torch.utils.data import DataLoader, TensorDataset
 
-from env import Engine, GameState, encode_state, render_board
-from mcts import MCTS, select_action
+from env import SYM_COUNT, SYM_MOVES, Engine, GameState, PuctTree, encode_states, render_board
+from mcts import MCTS, NativeMCTS, select_action
 from model import PolicyValueNet
 
 from tqdm import tqdm
@@ -39,7 +40,12 @@ def _cpu_state_dict(model):
     return {k: v.detach().cpu() for k, v in model.state_dict().items()}
 
 
-def _init_selfplay_worker(model_state, device, sims, mcts_batch, temp_moves, seed_base):
+def _make_mcts(impl, engine, model, sims, device, mcts_batch):
+    cls = NativeMCTS if impl == "native" else MCTS
+    return cls(engine, model, num_simulations=sims, device=device, batch_size=mcts_batch)
+
+
+def _init_selfplay_worker(model_state, device, sims, mcts_batch, mcts_impl, temp_moves, seed_base):
     global _WORKER_ENGINE, _WORKER_MCTS, _WORKER_TEMP_MOVES, _WORKER_SEED_BASE
     global _WORKER_LAST_HITS, _WORKER_LAST_MISSES
     torch.set_num_threads(1)
@@ -53,7 +59,7 @@ def _init_selfplay_worker(model_state, device, sims, mcts_batch, temp_moves, see
     model = PolicyValueNet().to(dev)
     model.load_state_dict(model_state)
     engine = Engine()
-    mcts = MCTS(engine, model, num_simulations=sims, device=dev, batch_size=mcts_batch)
+    mcts = _make_mcts(mcts_impl, engine, model, sims, dev, mcts_batch)
 
     _WORKER_ENGINE = engine
     _WORKER_MCTS = mcts
@@ -98,6 +104,10 @@ def self_play_game(engine, mcts, temperature_moves=8):
         if result != "n":
             break
         step += 1
+    return _label_history(history, result), result
+
+
+def _label_history(history, result):
     data = []
     for s, p in history:
         if result == "d":
@@ -105,7 +115,127 @@ def self_play_game(engine, mcts, temperature_moves=8):
         else:
             z = 1.0 if result == s.turn else -1.0
         data.append((s, p, z))
-    return data, result
+    return data
+
+
+class _ParallelGame:
+    def __init__(self, tree):
+        self.tree = tree
+        self.state = GameState(0, 0, "b")
+        self.history = []
+        self.step = 0
+        self.sims_left = 0
+        self.need_noise = False
+
+
+def self_play_games(
+    engine,
+    model,
+    games,
+    sims,
+    device,
+    parallel_games=64,
+    leaves_per_game=8,
+    temperature_moves=8,
+    c_puct=1.5,
+    dirichlet_alpha=0.3,
+    dirichlet_eps=0.25,
+    cache_entries=1 << 16,
+):
+    """Plays `games` self-play games, `parallel_games` at a time, in this process.
+
+    Every game keeps its own native PUCT tree with a `cache_entries` evaluation cache
+    (88 bytes per entry). Each step collects up to
+    `leaves_per_game` leaves from every running game into one input buffer, runs the
+    model once on the whole batch and hands each game its slice of the output.
+    Returns ([(data, result), ...], cache hits, cache misses).
+    """
+    parallel_games = max(1, min(parallel_games, games))
+    leaves_per_game = max(1, leaves_per_game)
+    # Each simulation expands at most one node (<= 16 children), so a move needs 16 * sims
+    # free nodes. The subtree kept by advance() can grow by that much every move, so it is
+    # dropped once it would leave less than that free (see start_move).
+    search_nodes = 16 * sims
+    max_nodes = max(4096, 2 * search_nodes + 64)
+    inputs = torch.empty((parallel_games * leaves_per_game, 2, 4, 4, 4), dtype=torch.float32)
+    policy = torch.empty(64, dtype=torch.float32)
+    finished = []
+    hits = 0
+    misses = 0
+    started = 0
+    running = []
+
+    def start_move(g):
+        g.tree.set_root_with_room(g.state, search_nodes)
+        g.sims_left = sims
+        g.need_noise = True
+
+    def start_game(tree):
+        nonlocal started
+        started += 1
+        g = _ParallelGame(tree)
+        start_move(g)
+        return g
+
+    for _ in range(parallel_games):
+        running.append(start_game(PuctTree(max_nodes, cache_entries, c_puct)))
+
+    model.eval()
+    with torch.inference_mode():
+        while running:
+            slots = []
+            offset = 0
+            for g in running:
+                if g.need_noise:
+                    moves, _ = g.tree.root_children()
+                    if moves:
+                        noise = np.random.dirichlet([dirichlet_alpha] * len(moves))
+                        g.tree.add_root_noise(noise, dirichlet_eps)
+                        g.need_noise = False
+                # An unexpanded root is evaluated alone first so the noise lands on its priors.
+                max_leaves = 1 if g.need_noise else leaves_per_game
+                n, done = g.tree.select(inputs[offset:], max_leaves, g.sims_left)
+                g.sims_left -= done
+                if n == 0 and done == 0:
+                    g.sims_left = 0
+                slots.append((g, offset, n))
+                offset += n
+
+            if offset > 0:
+                logits, values = model(inputs[:offset].to(device))
+                logits = logits.float().cpu().contiguous()
+                values = values.float().reshape(-1).cpu().contiguous()
+                for g, start, n in slots:
+                    if n > 0:
+                        g.tree.backup(logits[start : start + n], values[start : start + n])
+
+            still_running = []
+            for g in running:
+                if g.sims_left > 0:
+                    still_running.append(g)
+                    continue
+                temp = 1.0 if g.step < temperature_moves else 0.0
+                pi = g.tree.policy(temp, policy).numpy().copy()
+                g.history.append((g.state, pi))
+                action = select_action(pi) if temp > 0 else int(np.argmax(pi))
+                g.tree.advance(action)
+                g.state = engine.apply_move(g.state, action)
+                result = engine.result(g.state)
+                if result == "n":
+                    g.step += 1
+                    start_move(g)
+                    still_running.append(g)
+                    continue
+                finished.append((_label_history(g.history, result), result))
+                if started < games:
+                    still_running.append(start_game(g.tree))
+                else:
+                    h, m, _ = g.tree.stats()
+                    hits += h
+                    misses += m
+            running = still_running
+
+    return finished, hits, misses
 
 
 def _random_move(engine, state):
@@ -114,25 +244,15 @@ def _random_move(engine, state):
 
 
 def _heuristic_move(engine, state):
-    legal = engine.legal_moves_indices(state)
-    for mv in legal:
-        next_state = engine.apply_move(state, mv)
-        if engine.result(next_state) == state.turn:
-            return mv
+    wins = engine.winning_moves(state)
+    if wins:
+        return wins[0]
 
     opp_turn = "w" if state.turn == "b" else "b"
-    opp_state = GameState(state.black, state.white, opp_turn)
-    opp_legal = engine.legal_moves_indices(opp_state)
-    opp_wins = set()
-    for mv in opp_legal:
-        next_state = engine.apply_move(opp_state, mv)
-        if engine.result(next_state) == opp_turn:
-            opp_wins.add(mv)
-
-    blocking = [mv for mv in legal if mv in opp_wins]
+    blocking = engine.winning_moves(GameState(state.black, state.white, opp_turn))
     if blocking:
         return random.choice(blocking)
-    return random.choice(legal)
+    return random.choice(engine.legal_moves_indices(state))
 
 
 def _play_game(engine, move_b, move_w, mcts=None):
@@ -153,8 +273,8 @@ def _play_game(engine, move_b, move_w, mcts=None):
         moves += 1
 
 
-def _benchmark(engine, model, device, sims, games, mcts_batch):
-    mcts = MCTS(engine, model, num_simulations=sims, device=device, batch_size=mcts_batch)
+def _benchmark(engine, model, device, sims, games, mcts_batch, mcts_impl="python"):
+    mcts = _make_mcts(mcts_impl, engine, model, sims, device, mcts_batch)
 
     def mcts_move(state):
         policy = mcts.run(state, temperature=0.0, add_root_noise=False)
@@ -200,8 +320,19 @@ def _benchmark(engine, model, device, sims, games, mcts_batch):
     return results
 
 
+def augment_symmetries(engine, data):
+    """All SYM_COUNT images of each (state, policy, z) sample; the value target is unchanged."""
+    out = []
+    for s, p, z in data:
+        for t in range(SYM_COUNT):
+            mapped = np.empty_like(p)
+            mapped[SYM_MOVES[t]] = p
+            out.append((engine.transform(s, t), mapped, z))
+    return out
+
+
 def train_model(model, data, device, batch_size, epochs, lr):
-    states = torch.stack([encode_state(s) for s, _, _ in data]).to(device)
+    states = encode_states([s for s, _, _ in data]).to(device)
     policies = torch.from_numpy(np.stack([p for _, p, _ in data])).float().to(device)
     values = torch.from_numpy(np.array([[z] for _, _, z in data], dtype=np.float32)).to(device)
 
@@ -241,20 +372,36 @@ def cmd_selfplay(args):
     device = torch.device(args.device)
     engine = Engine()
     model = load_model(args.model, device)
-    mcts = MCTS(engine, model, num_simulations=args.sims, device=device, batch_size=args.mcts_batch)
 
     all_data = []
     results = {"b": 0, "w": 0, "d": 0}
-    for _ in range(args.games):
-        data, result = self_play_game(engine, mcts, temperature_moves=args.temp_moves)
-        all_data.extend(data)
-        results[result] += 1
+    if args.parallel_games > 0:
+        games, _, _ = self_play_games(
+            engine,
+            model,
+            args.games,
+            args.sims,
+            device,
+            parallel_games=args.parallel_games,
+            leaves_per_game=args.mcts_batch,
+            temperature_moves=args.temp_moves,
+            cache_entries=args.eval_cache,
+        )
+        for data, result in games:
+            all_data.extend(data)
+            results[result] += 1
+    else:
+        mcts = _make_mcts(args.mcts_impl, engine, model, args.sims, device, args.mcts_batch)
+        for _ in range(args.games):
+            data, result = self_play_game(engine, mcts, temperature_moves=args.temp_moves)
+            all_data.extend(data)
+            results[result] += 1
 
     print(f"self-play results: {results}")
     if args.out:
         out = Path(args.out)
         out.parent.mkdir(parents=True, exist_ok=True)
-        states = torch.stack([encode_state(s) for s, _, _ in all_data]).numpy()
+        states = encode_states([s for s, _, _ in all_data]).numpy()
         policies = np.stack([p for _, p, _ in all_data])
         values = np.array([z for _, _, z in all_data], dtype=np.float32)
         np.savez_compressed(out, states=states, policies=policies, values=values)
@@ -271,7 +418,24 @@ def cmd_train(args):
         all_data = []
         results = {"b": 0, "w": 0, "d": 0}
 
-        if args.selfplay_workers > 1:
+        if args.parallel_games > 0:
+            games, hits, misses = self_play_games(
+                engine,
+                model,
+                args.games_per_iter,
+                args.sims,
+                device,
+                parallel_games=args.parallel_games,
+                leaves_per_game=args.mcts_batch,
+                temperature_moves=args.temp_moves,
+                cache_entries=args.eval_cache,
+            )
+            for data, result in games:
+                all_data.extend(data)
+                results[result] += 1
+            total = hits + misses
+            hit_rate = (hits / total) if total else 0.0
+        elif args.selfplay_workers > 1:
             seed_base = random.randrange(1, 2**31 - 1)
             model_state = _cpu_state_dict(model)
             ctx = mp.get_context("spawn")
@@ -283,6 +447,7 @@ def cmd_train(args):
                     args.device,
                     args.sims,
                     args.mcts_batch,
+                    args.mcts_impl,
                     args.temp_moves,
                     seed_base,
                 ),
@@ -297,7 +462,7 @@ def cmd_train(args):
             total = hits + misses
             hit_rate = (hits / total) if total else 0.0
         else:
-            mcts = MCTS(engine, model, num_simulations=args.sims, device=device, batch_size=args.mcts_batch)
+            mcts = _make_mcts(args.mcts_impl, engine, model, args.sims, device, args.mcts_batch)
             for _ in range(args.games_per_iter):
                 data, result = self_play_game(engine, mcts, temperature_moves=args.temp_moves)
                 all_data.extend(data)
@@ -308,6 +473,8 @@ def cmd_train(args):
             f"iter {it + 1}: self-play {results}, samples={len(all_data)}, "
             f"cache hit {hit_rate * 100:.1f}% ({hits}/{hits + misses})"
         )
+        if args.augment_symmetry:
+            all_data = augment_symmetries(engine, all_data)
         train_model(model, all_data, device, args.batch_size, args.epochs, args.lr)
 
         if args.out:
@@ -315,7 +482,7 @@ def cmd_train(args):
             print(f"saved model: {args.out}")
 
         if args.bench_interval and (it + 1) % args.bench_interval == 0:
-            bench = _benchmark(engine, model, device, args.sims, args.bench_games, args.mcts_batch)
+            bench = _benchmark(engine, model, device, args.sims, args.bench_games, args.mcts_batch, args.mcts_impl)
             for name, stats in bench.items():
                 print(
                     f"benchmark vs {name}: "
@@ -332,7 +499,7 @@ def cmd_play(args):
     device = torch.device(args.device)
     engine = Engine()
     model = load_model(args.model, device)
-    mcts = MCTS(engine, model, num_simulations=args.sims, device=device, batch_size=args.mcts_batch)
+    mcts = _make_mcts(args.mcts_impl, engine, model, args.sims, device, args.mcts_batch)
 
     human = args.human
     state = GameState(0, 0, "b")
@@ -368,6 +535,27 @@ def cmd_play(args):
             state = next_state
 
 
+def cmd_perft(args):
+    engine = Engine()
+    state = GameState(0, 0, "b")
+    for token in args.position.replace(",", " ").split():
+        move = int(token)
+        if engine.result(state) != "n" or move not in engine.legal_moves_indices(state):
+            raise SystemExit(f"illegal move in --position: {move}")
+        state = engine.apply_move(state, move)
+    print(f"perft: black=0x{state.black:016x} white=0x{state.white:016x} turn={state.turn} "
+          f"bulk={int(not args.no_bulk)} threads={args.threads}")
+    for depth in range(1, args.depth + 1):
+        start = time.perf_counter()
+        c = engine.perft(state, depth, bulk=not args.no_bulk, threads=args.threads)
+        elapsed = time.perf_counter() - start
+        nps = c["nodes"] / elapsed if elapsed > 0 else 0.0
+        print(
+            f"perft depth={depth} leaves={c['leaves']} wins={c['wins']} draws={c['draws']} "
+            f"nodes={c['nodes']} time={elapsed * 1000.0:.1f}ms nps={nps:.0f}"
+        )
+
+
 def build_parser():
     p = argparse.ArgumentParser(description="Score-four AlphaZero minimal runner")
     sub = p.add_subparsers(dest="cmd", required=True)
@@ -377,6 +565,24 @@ def build_parser():
     sp.add_argument("--games", type=int, default=2)
     sp.add_argument("--sims", type=int, default=200)
     sp.add_argument("--mcts-batch", type=int, default=1, help="MCTS inference batch size")
+    sp.add_argument(
+        "--mcts-impl",
+        choices=["python", "native"],
+        default="python",
+        help="MCTS tree implementation (ignored with --parallel-games, which always uses the native tree)",
+    )
+    sp.add_argument(
+        "--parallel-games",
+        type=int,
+        default=0,
+        help="play N games at once in this process with one shared inference batch (native MCTS; 0=off)",
+    )
+    sp.add_argument(
+        "--eval-cache",
+        type=int,
+        default=1 << 16,
+        help="evaluation cache entries per game with --parallel-games (88 bytes each; 0=off)",
+    )
     sp.add_argument("--temp-moves", type=int, default=8)
     sp.add_argument("--out", default="", help="npz output path")
     sp.add_argument("--device", default="cpu")
@@ -389,9 +595,30 @@ def build_parser():
     tr.add_argument("--games-per-iter", type=int, default=4)
     tr.add_argument("--sims", type=int, default=200)
     tr.add_argument("--mcts-batch", type=int, default=1, help="MCTS inference batch size")
+    tr.add_argument(
+        "--mcts-impl",
+        choices=["python", "native"],
+        default="python",
+        help="MCTS tree implementation (ignored with --parallel-games, which always uses the native tree)",
+    )
+    tr.add_argument(
+        "--parallel-games",
+        type=int,
+        default=0,
+        help="play N games at once in this process with one shared inference batch (native MCTS; 0=off)",
+    )
+    tr.add_argument(
+        "--eval-cache",
+        type=int,
+        default=1 << 16,
+        help="evaluation cache entries per game with --parallel-games (88 bytes each; 0=off)",
+    )
     tr.add_argument("--temp-moves", type=int, default=8)
     tr.add_argument("--batch-size", type=int, default=64)
     tr.add_argument("--epochs", type=int, default=2)
+    tr.add_argument(
+        "--augment-symmetry", action="store_true", help="train on all 8 board symmetries of each sample"
+    )
     tr.add_argument("--lr", type=float, default=1e-3)
     tr.add_argument("--selfplay-workers", type=int, default=1, help="self-play worker processes")
     tr.add_argument("--bench-interval", type=int, default=0, help="run benchmark every N iters (0=disable)")
@@ -403,10 +630,18 @@ def build_parser():
     pl.add_argument("--model", default="", help="path to model file")
     pl.add_argument("--sims", type=int, default=200)
     pl.add_argument("--mcts-batch", type=int, default=1, help="MCTS inference batch size")
+    pl.add_argument("--mcts-impl", choices=["python", "native"], default="python", help="MCTS tree implementation")
     pl.add_argument("--human", choices=["b", "w", "n"], default="b")
     pl.add_argument("--device", default="cpu")
     pl.set_defaults(func=cmd_play)
 
+    pf = sub.add_parser("perft", help="count positions N plies ahead with the native engine")
+    pf.add_argument("depth", type=int)
+    pf.add_argument("--position", default="", help="moves played so far as cell indices (e.g. 0,16,5)")
+    pf.add_argument("--threads", type=int, default=0, help="worker threads (0=all CPUs)")
+    pf.add_argument("--no-bulk", action="store_true", help="play out the last ply instead of counting it")
+    pf.set_defaults(func=cmd_perft)
+
     return p
 
 
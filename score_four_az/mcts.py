@@ -4,7 +4,7 @@ import random
 import numpy as np
 import torch
 
-from env import encode_state
+from env import SYM_INVERSE, SYM_MOVES, PuctTree, encode_state, encode_states
 
 
 class Node:
@@ -177,9 +177,31 @@ class MCTS:
         node.W += value
         return value
 
+    # The cache is keyed by the canonical position (Engine.canonicalize), so symmetric
+    # positions share one evaluation. Entries hold the canonical position's moves in
+    # ascending order; lookups map them back to the caller's orientation.
+    def _cache_get(self, state):
+        canon, t = self.engine.canonicalize(state)
+        cached = self._cache.get((canon.black, canon.white, canon.turn))
+        if cached is None or t == 0:
+            return cached
+        moves, probs, value = cached
+        back = SYM_MOVES[SYM_INVERSE[t]]
+        order = sorted(range(len(moves)), key=lambda i: back[moves[i]])
+        return tuple(back[moves[i]] for i in order), probs[order], value
+
+    def _cache_put(self, state, legal_moves, probs, value):
+        canon, t = self.engine.canonicalize(state)
+        fwd = SYM_MOVES[t]
+        order = sorted(range(len(legal_moves)), key=lambda i: fwd[legal_moves[i]])
+        self._cache[(canon.black, canon.white, canon.turn)] = (
+            tuple(fwd[legal_moves[i]] for i in order),
+            probs[order],
+            value,
+        )
+
     def _expand(self, state, node, add_root_noise=False):
-        key = (state.black, state.white, state.turn)
-        cached = self._cache.get(key)
+        cached = self._cache_get(state)
         if cached is None:
             self._cache_misses += 1
             legal_moves = self.engine.legal_moves_indices(state)
@@ -193,7 +215,7 @@ class MCTS:
             idx = torch.tensor(legal_moves, device=logits.device)
             probs_legal = torch.softmax(logits.index_select(0, idx), dim=0)
             base_probs_legal = probs_legal.detach().cpu().numpy()
-            self._cache[key] = (tuple(legal_moves), base_probs_legal, value)
+            self._cache_put(state, legal_moves, base_probs_legal, value)
         else:
             self._cache_hits += 1
             legal_moves, base_probs_legal, value = cached
@@ -240,8 +262,7 @@ class MCTS:
                 return "value", (path, value)
 
             if not node.expanded:
-                key = (cur_state.black, cur_state.white, cur_state.turn)
-                cached = self._cache.get(key)
+                cached = self._cache_get(cur_state)
                 if cached is not None:
                     self._cache_hits += 1
                     legal_moves, base_probs_legal, value = cached
@@ -278,7 +299,7 @@ class MCTS:
         if not items:
             return
         self._cache_misses += len(items)
-        states = torch.stack([encode_state(s) for _, s, _, _ in items]).to(self.device)
+        states = encode_states([s for _, s, _, _ in items]).to(self.device)
         with torch.inference_mode():
             logits, values = self.model(states)
         for i, (path, state, node, add_root_noise) in enumerate(items):
@@ -291,7 +312,7 @@ class MCTS:
             idx = torch.tensor(legal_moves, device=logit.device)
             probs_legal = torch.softmax(logit.index_select(0, idx), dim=0)
             base_probs_legal = probs_legal.detach().cpu().numpy()
-            self._cache[(state.black, state.white, state.turn)] = (tuple(legal_moves), base_probs_legal, value)
+            self._cache_put(state, legal_moves, base_probs_legal, value)
             if not node.expanded:
                 self._expand_from_cache(node, legal_moves, base_probs_legal, add_root_noise=add_root_noise)
             self._backup(path, value)
@@ -302,6 +323,88 @@ class MCTS:
         return self._cache_hits, self._cache_misses, hit_rate
 
 
+class NativeMCTS:
+    """Same interface and search as MCTS, with the tree walk in libscorefour.
+
+    The native tree selects up to `batch_size` leaves per step with virtual loss,
+    so one forward pass evaluates a whole batch; terminal positions and cached
+    evaluations never reach Python.
+    """
+
+    def __init__(
+        self,
+        engine,
+        model,
+        num_simulations=200,
+        c_puct=1.5,
+        dirichlet_alpha=0.3,
+        dirichlet_eps=0.25,
+        device="cpu",
+        batch_size=8,
+        max_nodes=1 << 20,
+        cache_entries=1 << 16,
+    ):
+        self.engine = engine
+        self.model = model
+        self.num_simulations = num_simulations
+        self.c_puct = c_puct
+        self.dirichlet_alpha = dirichlet_alpha
+        self.dirichlet_eps = dirichlet_eps
+        self.device = device
+        self.batch_size = max(1, batch_size)
+        self._max_nodes = max_nodes
+        self._cache_entries = cache_entries
+        self._tree = PuctTree(max_nodes, cache_entries, c_puct)
+        self._inputs = torch.empty((self.batch_size, 2, 4, 4, 4), dtype=torch.float32)
+        self._policy = torch.empty(64, dtype=torch.float32)
+        self.model.eval()
+
+    def reset(self):
+        self._tree = PuctTree(self._max_nodes, self._cache_entries, self.c_puct)
+
+    def advance_to(self, state, action, next_state=None):
+        # A root that is not `state` is reset to it first; advancing then starts a fresh tree.
+        self._tree.set_root(state)
+        self._tree.advance(action)
+
+    def _simulate(self, budget):
+        done_total = 0
+        while done_total < budget:
+            n, done = self._tree.select(self._inputs, self.batch_size, budget - done_total)
+            done_total += done
+            if n > 0:
+                logits, values = self.model(self._inputs[:n].to(self.device))
+                logits = logits.float().cpu().contiguous()
+                values = values.float().reshape(-1).cpu().contiguous()
+                self._tree.backup(logits, values)
+            elif done == 0:
+                break
+        return done_total
+
+    def run(self, state, temperature=1.0, add_root_noise=True):
+        # Each simulation expands at most one node (<= 16 children).
+        self._tree.set_root_with_room(state, 16 * self.num_simulations)
+        sims = 0
+        with torch.inference_mode():
+            if add_root_noise:
+                moves, _ = self._tree.root_children()
+                if not moves:
+                    # Expand the root first so the noise lands on its priors.
+                    sims = self._simulate(1)
+                    moves, _ = self._tree.root_children()
+                if moves:
+                    noise = np.random.dirichlet([self.dirichlet_alpha] * len(moves))
+                    self._tree.add_root_noise(noise, self.dirichlet_eps)
+            self._simulate(self.num_simulations - sims)
+        return self._tree.policy(temperature, self._policy).numpy().copy()
+
+    def cache_stats(self):
+        hits, misses, _ = self._tree.stats()
+        total = hits + misses
+        hit_rate = (hits / total) if total else 0.0
+        return hits, misses, hit_rate
+
+
 def select_action(policy):
     r = random.random()
     cdf = 0.0
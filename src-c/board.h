@@ -0,0 +1,178 @@
+#ifndef SCORE_FOUR_BOARD_H
+#define SCORE_FOUR_BOARD_H
+
+// Bitboard core shared by the CLI (main.c) and libscorefour (engine.c). The tables live
+// in engine.c and are filled by board_init(); the hot helpers are inline here so every
+// caller gets them without a call. Boards are 64-bit masks with cell index 0 at the MSB;
+// index = x + 4y + 16z, so the cell above is one bit `>> 16`.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define BOARD_HIDDEN __attribute__((visibility("hidden")))
+#else
+#define BOARD_HIDDEN
+#endif
+
+#define BOARD_TOP_BIT UINT64_C(0x8000000000000000)
+#define BOARD_FIRST_FLOOR UINT64_C(0xFFFF000000000000)
+#define BOARD_LINES 76
+#define MAX_CELL_LINES 16
+#define LINE_DIRECTIONS 13
+#define SYM_COUNT 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+BOARD_HIDDEN extern const uint64_t conditions[BOARD_LINES];
+
+// For fast "did the last move win?" checks in rollouts/expansions.
+BOARD_HIDDEN extern uint8_t g_cell_lines_count[64];
+BOARD_HIDDEN extern uint64_t g_cell_lines[64][MAX_CELL_LINES];
+BOARD_HIDDEN extern uint8_t g_cell_line_ids[64][MAX_CELL_LINES];   // index into conditions[]
+
+// Every line has a constant index step, one of 13 directions; g_line_pos_masks[d][p] holds
+// the p-th cell (in index order) of every line in direction d. See threat_cells().
+static const int k_line_strides[LINE_DIRECTIONS] = {1, 4, 16, 5, 3, 17, 15, 20, 12, 21, 19, 13, 11};
+BOARD_HIDDEN extern uint64_t g_line_pos_masks[LINE_DIRECTIONS][4];
+
+// Board symmetries. Gravity pins the vertical axis, so of the 192 line-preserving maps
+// of the 4x4x4 cube only the 8 symmetries of the square, applied to every layer, keep
+// legal positions legal. Transform t maps column (x, y) to (a, b) with (a, b) = (y, x)
+// if t & 4, then a = 3 - a if t & 1 and b = 3 - b if t & 2. Each layer is two bytes, so
+// a board is mapped with 8 byte lookups.
+BOARD_HIDDEN extern uint8_t g_sym_cell[SYM_COUNT][64];
+BOARD_HIDDEN extern uint8_t g_sym_inverse[SYM_COUNT];
+BOARD_HIDDEN extern uint16_t g_sym_layer[SYM_COUNT][2][256];   // [t][0]: cells 0-7 of a layer, [t][1]: cells 8-15
+
+// which_is_win() and line_diff() test every conditions[] mask. The scalar versions are
+// the reference; the AVX2 (4 masks) and AVX-512 (8 masks) versions give identical
+// results and are selected once by board_init().
+typedef struct {
+    const char *name;
+    char (*which_is_win)(uint64_t black_board, uint64_t white_board);
+    int (*line_diff)(uint64_t black_board, uint64_t white_board);
+} LineKernels;
+
+BOARD_HIDDEN extern LineKernels g_line_kernels;
+
+BOARD_HIDDEN char which_is_win_scalar(uint64_t black_board, uint64_t white_board);
+// Lines holding only black pieces minus lines holding only white pieces.
+BOARD_HIDDEN int line_diff_scalar(uint64_t black_board, uint64_t white_board);
+// Fills out[] with every kernel set this CPU can run, scalar first. Returns the count.
+BOARD_HIDDEN int available_line_kernels(const LineKernels *out[3]);
+
+// Fills the tables above and picks the widest supported kernels
+// (SCORE_FOUR_KERNELS=scalar|avx2|avx512 overrides). Safe to call more than once.
+BOARD_HIDDEN void board_init(void);
+
+static inline uint64_t index_to_bit(int index) {
+    if (index < 0 || index >= 64) return 0;
+    return BOARD_TOP_BIT >> (unsigned)index;
+}
+
+static inline int bit_to_index(uint64_t bit) {
+    if (bit == 0) return -1;
+    return (int)__builtin_clzll(bit);
+}
+
+static inline uint64_t get_possible_pos_board(uint64_t black_board, uint64_t white_board) {
+    const uint64_t board = black_board | white_board;
+    return ((board >> 16) ^ board) ^ BOARD_FIRST_FLOOR;
+}
+
+// Move masks (e.g. get_possible_pos_board()) are walked from the most significant bit,
+// i.e. in increasing index order, so every caller sees moves in the same order.
+static inline uint64_t first_move(uint64_t moves) {
+    return BOARD_TOP_BIT >> __builtin_clzll(moves);
+}
+
+static inline int count_moves(uint64_t moves) {
+    return __builtin_popcountll(moves);
+}
+
+static inline int get_possible_poses_binary(uint64_t black_board, uint64_t white_board, uint64_t array[16]) {
+    uint64_t possible_pos_board = get_possible_pos_board(black_board, white_board);
+    int array_index = 0;
+    while (possible_pos_board != 0) {
+        const uint64_t bit = first_move(possible_pos_board);
+        array[array_index++] = bit;
+        possible_pos_board ^= bit;
+    }
+    return array_index;
+}
+
+// Returns 'b', 'w', 'd' (board full) or 'n' (ongoing).
+static inline char which_is_win(uint64_t black_board, uint64_t white_board) {
+    return g_line_kernels.which_is_win(black_board, white_board);
+}
+
+static inline int line_diff(uint64_t black_board, uint64_t white_board) {
+    return g_line_kernels.line_diff(black_board, white_board);
+}
+
+static inline bool is_win_after_move(uint64_t player_board_after, uint64_t last_move_bit) {
+    const int idx = bit_to_index(last_move_bit);
+    if (idx < 0) return false;
+    const uint8_t n = g_cell_lines_count[idx];
+    for (uint8_t i = 0; i < n; i++) {
+        const uint64_t mask = g_cell_lines[idx][i];
+        if ((player_board_after & mask) == mask) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Empty cells where `own` would complete a line. For each direction, a cell at position p
+// of a line is a threat when the pieces pulled in from the other three positions are all
+// own; `own << k` moves the piece on cell i+k onto cell i.
+static inline uint64_t threat_cells(uint64_t own, uint64_t opp) {
+    uint64_t threats = 0;
+    for (int d = 0; d < LINE_DIRECTIONS; d++) {
+        const int k = k_line_strides[d];
+        const uint64_t n1 = own << k, n2 = own << (2 * k), n3 = own << (3 * k);
+        const uint64_t p1 = own >> k, p2 = own >> (2 * k), p3 = own >> (3 * k);
+        threats |= g_line_pos_masks[d][0] & n1 & n2 & n3;
+        threats |= g_line_pos_masks[d][1] & p1 & n1 & n2;
+        threats |= g_line_pos_masks[d][2] & p2 & p1 & n1;
+        threats |= g_line_pos_masks[d][3] & p3 & p2 & p1;
+    }
+    return threats & ~(own | opp);
+}
+
+static inline uint64_t sym_board(uint64_t board, int t) {
+    uint64_t out = 0;
+    for (int shift = 0; shift < 64; shift += 16) {
+        const uint32_t layer = (uint32_t)(board >> shift);
+        out |= (uint64_t)(g_sym_layer[t][0][(layer >> 8) & 0xff] | g_sym_layer[t][1][layer & 0xff]) << shift;
+    }
+    return out;
+}
+
+// Maps (black, white) to the smallest of its 8 images and returns the transform used.
+static inline int sym_canonicalize(uint64_t black, uint64_t white, uint64_t *out_black, uint64_t *out_white) {
+    uint64_t best_b = black, best_w = white;
+    int best_t = 0;
+    for (int t = 1; t < SYM_COUNT; t++) {
+        const uint64_t b = sym_board(black, t);
+        if (b > best_b) continue;
+        const uint64_t w = sym_board(white, t);
+        if (b < best_b || w < best_w) {
+            best_b = b;
+            best_w = w;
+            best_t = t;
+        }
+    }
+    *out_black = best_b;
+    *out_white = best_w;
+    return best_t;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,5 +1,9 @@
 #!/usr/bin/env bash
 set -euo pipefail
+cd "$(dirname "$0")"
 
-gcc -shared -fPIC -O3 -o libscorefour.so engine.c
+# One bitboard core (engine.c + board.h) for both targets; -flto lets the CLI inline it.
+gcc -shared -fPIC -O3 -flto -pthread -o libscorefour.so engine.c -lm
 echo "built: $(pwd)/libscorefour.so"
+gcc -O3 -march=native -flto -fopenmp -pthread -o score_four main.c engine.c -lm
+echo "built: $(pwd)/score_four"
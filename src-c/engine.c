@@ -1,13 +1,18 @@
 #include "engine.h"
+#include "board.h"
 
 #include <stdbool.h>
 #include <string.h>
 #include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-static const uint64_t k_top_bit = UINT64_C(0x8000000000000000);
-static const uint64_t k_first_floor = UINT64_C(0xFFFF000000000000);
-
-static const uint64_t conditions[76] = {
+const uint64_t conditions[BOARD_LINES] = {
     0b1111000000000000000000000000000000000000000000000000000000000000,
     0b0000111100000000000000000000000000000000000000000000000000000000,
     0b0000000011110000000000000000000000000000000000000000000000000000,
@@ -70,8 +75,8 @@ static const uint64_t conditions[76] = {
     0b0000000000000001000000000000001000000000000001000000000000001000,
     0b1000000000000000010000000000000000100000000000000001000000000000,
     0b0000100000000000000001000000000000000010000000000000000100000000,
-    0b0000000010000000000000000100000000000000000100000000000000010000,
-    0b0000000000001000000000000000010000000000000000010000000000000001,
+    0b0000000010000000000000000100000000000000001000000000000000010000,
+    0b0000000000001000000000000000010000000000000000100000000000000001,
     0b1000000000000000000010000000000000000000100000000000000000001000,
     0b0100000000000000000001000000000000000000010000000000000000000100,
     0b0010000000000000000000100000000000000000001000000000000000000010,
@@ -82,100 +87,271 @@ static const uint64_t conditions[76] = {
     0b0000000000000001000000000001000000000001000000000001000000000000,
     0b0000000000000001000000000010000000000100000000001000000000000000,
     0b1000000000000000000001000000000000000000001000000000000000000001,
-    0b0001000000000000000000100000000000000000100000000000000000001000,
+    0b0001000000000000000000100000000000000000010000000000000000001000,
     0b0000000000001000000000000100000000000010000000000001000000000000
 };
 
-#define MAX_CELL_LINES 16
-static uint8_t g_cell_lines_count[64];
-static uint64_t g_cell_lines[64][MAX_CELL_LINES];
-static bool g_inited = false;
+uint8_t g_cell_lines_count[64];
+uint64_t g_cell_lines[64][MAX_CELL_LINES];
+uint8_t g_cell_line_ids[64][MAX_CELL_LINES];
+uint64_t g_line_pos_masks[LINE_DIRECTIONS][4];
 
 static void init_cell_lines(void) {
     memset(g_cell_lines_count, 0, sizeof(g_cell_lines_count));
-    for (int li = 0; li < 76; li++) {
+    for (int li = 0; li < BOARD_LINES; li++) {
         const uint64_t mask = conditions[li];
         for (int idx = 0; idx < 64; idx++) {
-            const uint64_t bit = (uint64_t)k_top_bit >> idx;
+            const uint64_t bit = BOARD_TOP_BIT >> idx;
             if ((mask & bit) == 0) continue;
             uint8_t n = g_cell_lines_count[idx];
             if (n < MAX_CELL_LINES) {
                 g_cell_lines[idx][n] = mask;
+                g_cell_line_ids[idx][n] = (uint8_t)li;
                 g_cell_lines_count[idx] = (uint8_t)(n + 1);
             }
         }
     }
-    g_inited = true;
+
+    memset(g_line_pos_masks, 0, sizeof(g_line_pos_masks));
+    for (int li = 0; li < BOARD_LINES; li++) {
+        int cells[4];
+        int n = 0;
+        for (int idx = 0; idx < 64 && n < 4; idx++) {
+            if (conditions[li] & (BOARD_TOP_BIT >> idx)) cells[n++] = idx;
+        }
+        // Every line is evenly spaced, so its first step names its direction.
+        const int stride = cells[1] - cells[0];
+        int dir = 0;
+        while (dir < LINE_DIRECTIONS - 1 && k_line_strides[dir] != stride) dir++;
+        for (int p = 0; p < 4; p++) {
+            g_line_pos_masks[dir][p] |= BOARD_TOP_BIT >> cells[p];
+        }
+    }
 }
 
-static inline int bit_to_index(uint64_t bit) {
-    if (bit == 0) return -1;
-#if ULONG_MAX == 0xffffffffffffffffUL
-    return (int)__builtin_clzll(bit);
-#else
-    int x = 0;
-    uint64_t msb = UINT64_C(1) << ((int)(sizeof(uint64_t) * 8) - 1);
-    while ((bit & msb) == 0) {
-        bit <<= 1;
-        x++;
+// ----------------------------
+// Line kernels (runtime SIMD dispatch)
+// ----------------------------
+char which_is_win_scalar(uint64_t black_board, uint64_t white_board) {
+    for (int i = 0; i < BOARD_LINES; i++) {
+        const uint64_t cond = conditions[i];
+        if ((black_board & cond) == cond) {
+            return 'b';
+        } else if ((white_board & cond) == cond) {
+            return 'w';
+        }
     }
-    return x;
-#endif
+    if (get_possible_pos_board(black_board, white_board) == 0) {
+        return 'd';
+    }
+
+    return 'n';
+}
+
+int line_diff_scalar(uint64_t black_board, uint64_t white_board) {
+    int diff = 0;
+    for (int i = 0; i < BOARD_LINES; i++) {
+        if (((black_board & conditions[i]) > 0) && ((white_board & conditions[i]) == 0)) {
+            diff++;
+        } else if (((black_board & conditions[i]) == 0) && ((white_board & conditions[i]) > 0)) {
+            diff--;
+        }
+    }
+    return diff;
 }
 
-static inline uint64_t index_to_bit(int index) {
-    if (index < 0 || index >= 64) return 0;
-    return (uint64_t)k_top_bit >> (unsigned)index;
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_SIMD_LINE_KERNELS 1
+
+__attribute__((target("avx2")))
+static char which_is_win_avx2(uint64_t black_board, uint64_t white_board) {
+    const __m256i vb = _mm256_set1_epi64x((long long)black_board);
+    const __m256i vw = _mm256_set1_epi64x((long long)white_board);
+    for (int i=0; i<76; i+=4) {
+        const __m256i m = _mm256_loadu_si256((const __m256i*)&conditions[i]);
+        const int hb = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(vb, m), m)));
+        const int hw = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(vw, m), m)));
+        if ((hb | hw) != 0) {
+            // Same answer as the scalar scan: the first matching mask decides, black first.
+            const int lane = __builtin_ctz((unsigned)(hb | hw));
+            return ((hb >> lane) & 1) ? 'b' : 'w';
+        }
+    }
+    return (get_possible_pos_board(black_board, white_board) == 0) ? 'd' : 'n';
 }
 
-static inline uint64_t get_possible_pos_board(uint64_t black_board, uint64_t white_board) {
-    uint64_t board = black_board | white_board;
-    return ((board >> 16) ^ board) ^ k_first_floor;
+__attribute__((target("avx2")))
+static int line_diff_avx2(uint64_t black_board, uint64_t white_board) {
+    const __m256i vb = _mm256_set1_epi64x((long long)black_board);
+    const __m256i vw = _mm256_set1_epi64x((long long)white_board);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    for (int i=0; i<76; i+=4) {
+        const __m256i m = _mm256_loadu_si256((const __m256i*)&conditions[i]);
+        const __m256i b_empty = _mm256_cmpeq_epi64(_mm256_and_si256(vb, m), zero);
+        const __m256i w_empty = _mm256_cmpeq_epi64(_mm256_and_si256(vw, m), zero);
+        // Compare results are -1 per matching lane.
+        acc = _mm256_sub_epi64(acc, _mm256_andnot_si256(b_empty, w_empty));
+        acc = _mm256_add_epi64(acc, _mm256_andnot_si256(w_empty, b_empty));
+    }
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    return (int)(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
 }
 
-static inline int get_possible_poses_binary(uint64_t black_board, uint64_t white_board,
-                                            uint64_t array[16]) {
-    uint64_t board = k_top_bit;
-    uint64_t possible_pos_board = get_possible_pos_board(black_board, white_board);
-    int array_index = 0;
-    for (int i = 0; i < 64; i++) {
-        if ((possible_pos_board & (board >> i)) != 0) {
-            array[array_index] = board >> i;
-            array_index++;
+__attribute__((target("avx512f")))
+static char which_is_win_avx512(uint64_t black_board, uint64_t white_board) {
+    const __m512i vb = _mm512_set1_epi64((long long)black_board);
+    const __m512i vw = _mm512_set1_epi64((long long)white_board);
+    for (int i=0; i<76; i+=8) {
+        const __mmask8 k = (i + 8 <= 76) ? (__mmask8)0xff : (__mmask8)((1u << (76 - i)) - 1);
+        const __m512i m = _mm512_maskz_loadu_epi64(k, &conditions[i]);
+        const unsigned hb = _mm512_mask_cmpeq_epi64_mask(k, _mm512_and_si512(vb, m), m);
+        const unsigned hw = _mm512_mask_cmpeq_epi64_mask(k, _mm512_and_si512(vw, m), m);
+        if ((hb | hw) != 0) {
+            const int lane = __builtin_ctz(hb | hw);
+            return ((hb >> lane) & 1) ? 'b' : 'w';
         }
     }
-    return array_index;
+    return (get_possible_pos_board(black_board, white_board) == 0) ? 'd' : 'n';
 }
 
-static inline char which_is_win(uint64_t black_board, uint64_t white_board) {
-    for (int i = 0; i < 76; i++) {
-            const uint64_t cond = conditions[i];
-        if ((black_board & cond) == cond) {
-            return 'b';
-        } else if ((white_board & cond) == cond) {
-            return 'w';
+__attribute__((target("avx512f")))
+static int line_diff_avx512(uint64_t black_board, uint64_t white_board) {
+    const __m512i vb = _mm512_set1_epi64((long long)black_board);
+    const __m512i vw = _mm512_set1_epi64((long long)white_board);
+    int diff = 0;
+    for (int i=0; i<76; i+=8) {
+        const __mmask8 k = (i + 8 <= 76) ? (__mmask8)0xff : (__mmask8)((1u << (76 - i)) - 1);
+        const __m512i m = _mm512_maskz_loadu_epi64(k, &conditions[i]);
+        const unsigned b_any = _mm512_mask_test_epi64_mask(k, vb, m);
+        const unsigned w_any = _mm512_mask_test_epi64_mask(k, vw, m);
+        diff += __builtin_popcount(b_any & ~w_any) - __builtin_popcount(w_any & ~b_any);
+    }
+    return diff;
+}
+#endif
+
+static const LineKernels k_line_kernels_scalar = {"scalar", which_is_win_scalar, line_diff_scalar};
+#ifdef HAVE_SIMD_LINE_KERNELS
+static const LineKernels k_line_kernels_avx2 = {"avx2", which_is_win_avx2, line_diff_avx2};
+static const LineKernels k_line_kernels_avx512 = {"avx512", which_is_win_avx512, line_diff_avx512};
+#endif
+
+LineKernels g_line_kernels = {"scalar", which_is_win_scalar, line_diff_scalar};
+
+int available_line_kernels(const LineKernels *out[3]) {
+    int n = 0;
+    out[n++] = &k_line_kernels_scalar;
+#ifdef HAVE_SIMD_LINE_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) out[n++] = &k_line_kernels_avx2;
+    if (__builtin_cpu_supports("avx512f")) out[n++] = &k_line_kernels_avx512;
+#endif
+    return n;
+}
+
+static void init_line_kernels(void) {
+    const LineKernels *avail[3];
+    const int n = available_line_kernels(avail);
+    g_line_kernels = *avail[n - 1];
+    const char *want = getenv("SCORE_FOUR_KERNELS");
+    if (want != NULL) {
+        for (int i = 0; i < n; i++) {
+            if (strcmp(avail[i]->name, want) == 0) g_line_kernels = *avail[i];
         }
     }
-    if (get_possible_pos_board(black_board, white_board) == 0) {
-        return 'd';
+}
+
+uint8_t g_sym_cell[SYM_COUNT][64];
+uint8_t g_sym_inverse[SYM_COUNT];
+uint16_t g_sym_layer[SYM_COUNT][2][256];
+
+static void init_sym_tables(void) {
+    for (int t = 0; t < SYM_COUNT; t++) {
+        for (int idx = 0; idx < 64; idx++) {
+            const int x = idx & 3, y = (idx >> 2) & 3, z = idx >> 4;
+            int a = (t & 4) ? y : x;
+            int b = (t & 4) ? x : y;
+            if (t & 1) a = 3 - a;
+            if (t & 2) b = 3 - b;
+            g_sym_cell[t][idx] = (uint8_t)(a + 4 * b + 16 * z);
+        }
+        for (int half = 0; half < 2; half++) {
+            for (int v = 0; v < 256; v++) {
+                uint16_t out = 0;
+                for (int k = 0; k < 8; k++) {
+                    if ((v >> (7 - k)) & 1) out |= (uint16_t)(0x8000u >> g_sym_cell[t][8 * half + k]);
+                }
+                g_sym_layer[t][half][v] = out;
+            }
+        }
+    }
+    for (int t = 0; t < SYM_COUNT; t++) {
+        for (int u = 0; u < SYM_COUNT; u++) {
+            if (g_sym_cell[u][g_sym_cell[t][1]] == 1 && g_sym_cell[u][g_sym_cell[t][4]] == 4) g_sym_inverse[t] = (uint8_t)u;
+        }
     }
-    return 'n';
 }
 
-void az_init(void) {
-    if (!g_inited) {
-        init_cell_lines();
+void board_init(void) {
+    static bool inited = false;
+    if (inited) return;
+    init_cell_lines();
+    init_line_kernels();
+    init_sym_tables();
+    inited = true;
+}
+
+uint64_t az_sym_board(uint64_t board, int transform) {
+    return sym_board(board, transform & (AZ_SYM_COUNT - 1));
+}
+
+int az_sym_move(int index, int transform) {
+    if (index < 0 || index >= 64) return -1;
+    return g_sym_cell[transform & (AZ_SYM_COUNT - 1)][index];
+}
+
+int az_sym_inverse(int transform) {
+    return g_sym_inverse[transform & (AZ_SYM_COUNT - 1)];
+}
+
+int az_canonicalize(uint64_t black, uint64_t white, uint64_t *out_black, uint64_t *out_white) {
+    return sym_canonicalize(black, white, out_black, out_white);
+}
+
+void az_canonicalize_batch(int n, const uint64_t *black, const uint64_t *white,
+                           uint64_t *out_black, uint64_t *out_white, uint8_t *out_transforms) {
+    for (int i = 0; i < n; i++) {
+        uint64_t cb, cw;
+        const int t = sym_canonicalize(black[i], white[i], &cb, &cw);
+        out_black[i] = cb;
+        out_white[i] = cw;
+        if (out_transforms) out_transforms[i] = (uint8_t)t;
     }
 }
 
+void az_init(void) {
+    board_init();
+}
+
 int az_legal_moves(uint64_t black, uint64_t white, uint64_t out_moves[16]) {
     return get_possible_poses_binary(black, white, out_moves);
 }
 
+uint64_t az_legal_mask(uint64_t black, uint64_t white) {
+    return get_possible_pos_board(black, white);
+}
+
 char az_result(uint64_t black, uint64_t white) {
     return which_is_win(black, white);
 }
 
+uint64_t az_winning_moves(uint64_t black, uint64_t white, char turn) {
+    const uint64_t own = (turn == 'b') ? black : white;
+    const uint64_t opp = (turn == 'b') ? white : black;
+    return threat_cells(own, opp) & get_possible_pos_board(black, white);
+}
+
 void az_apply_move(uint64_t black, uint64_t white, char turn, uint64_t move,
                    uint64_t *out_black, uint64_t *out_white) {
     uint64_t nb = black;
@@ -196,3 +372,672 @@ int az_move_index(uint64_t move) {
 uint64_t az_move_bit(int index) {
     return index_to_bit(index);
 }
+
+// Batched variants: position i is (black[i], white[i]). One call fills the whole
+// output buffer, so Python pays the FFI cost once per batch instead of per position.
+
+void az_legal_mask_batch(int n, const uint64_t *black, const uint64_t *white, uint64_t *out_masks) {
+    for (int i = 0; i < n; i++) {
+        out_masks[i] = get_possible_pos_board(black[i], white[i]);
+    }
+}
+
+void az_result_batch(int n, const uint64_t *black, const uint64_t *white, char *out_results) {
+    for (int i = 0; i < n; i++) {
+        out_results[i] = which_is_win(black[i], white[i]);
+    }
+}
+
+void az_apply_move_batch(int n, const uint64_t *black, const uint64_t *white, const char *turns,
+                         const int32_t *moves, uint64_t *out_black, uint64_t *out_white) {
+    for (int i = 0; i < n; i++) {
+        const uint64_t mv = index_to_bit(moves[i]);
+        out_black[i] = black[i] | ((turns[i] == 'b') ? mv : 0);
+        out_white[i] = white[i] | ((turns[i] == 'w') ? mv : 0);
+    }
+}
+
+// Perft: counts the positions exactly `depth` plies below (black, white). A won or drawn
+// game ends its branch and is counted in wins/draws at the ply where it ends (and as a
+// leaf if that is the last ply). Moves are played and judged with which_is_win(), the
+// same path as az_result(); with `bulk` the last ply only tests the lines through each
+// move instead.
+
+typedef struct {
+    int64_t leaves;
+    int64_t wins;
+    int64_t draws;
+    int64_t nodes;
+} PerftCounts;
+
+static void perft_count(uint64_t black, uint64_t white, char turn, int depth, bool bulk, PerftCounts *c) {
+    uint64_t moves = get_possible_pos_board(black, white);
+    if (bulk && depth == 1) {
+        const uint64_t own = (turn == 'b') ? black : white;
+        const bool last_cell = (__builtin_popcountll(black | white) == 63);
+        while (moves) {
+            const uint64_t mv = first_move(moves);
+            moves ^= mv;
+            c->leaves++;
+            c->nodes++;
+            if (is_win_after_move(own | mv, mv)) {
+                c->wins++;
+            } else if (last_cell) {
+                c->draws++;
+            }
+        }
+        return;
+    }
+    while (moves) {
+        const uint64_t mv = first_move(moves);
+        moves ^= mv;
+        const uint64_t nb = (turn == 'b') ? (black | mv) : black;
+        const uint64_t nw = (turn == 'w') ? (white | mv) : white;
+        const char result = which_is_win(nb, nw);
+        c->nodes++;
+        if (depth == 1) c->leaves++;
+        if (result != 'n') {
+            if (result == 'd') c->draws++; else c->wins++;
+            continue;
+        }
+        if (depth > 1) perft_count(nb, nw, (turn == 'b') ? 'w' : 'b', depth - 1, bulk, c);
+    }
+}
+
+#define PERFT_SPLIT_PLIES 2
+
+typedef struct {
+    const uint64_t (*frontier)[2];
+    int len;
+    int *next;                 // shared work index
+    char turn;
+    int depth;
+    bool bulk;
+    PerftCounts counts;
+} PerftJob;
+
+static void *perft_worker(void *arg) {
+    PerftJob *job = (PerftJob *)arg;
+    for (;;) {
+        const int i = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED);
+        if (i >= job->len) break;
+        perft_count(job->frontier[i][0], job->frontier[i][1], job->turn, job->depth, job->bulk, &job->counts);
+    }
+    return NULL;
+}
+
+// Collects the ongoing positions `plies` plies down into `frontier`, counting the games
+// that end on the way in *c.
+static int perft_frontier(uint64_t black, uint64_t white, char turn, int plies,
+                          uint64_t (*frontier)[2], int len, PerftCounts *c) {
+    if (plies == 0) {
+        frontier[len][0] = black;
+        frontier[len][1] = white;
+        return len + 1;
+    }
+    uint64_t moves = get_possible_pos_board(black, white);
+    while (moves) {
+        const uint64_t mv = first_move(moves);
+        moves ^= mv;
+        const uint64_t nb = (turn == 'b') ? (black | mv) : black;
+        const uint64_t nw = (turn == 'w') ? (white | mv) : white;
+        const char result = which_is_win(nb, nw);
+        c->nodes++;
+        if (result != 'n') {
+            if (result == 'd') c->draws++; else c->wins++;
+            continue;
+        }
+        len = perft_frontier(nb, nw, (turn == 'b') ? 'w' : 'b', plies - 1, frontier, len, c);
+    }
+    return len;
+}
+
+int64_t az_perft(uint64_t black, uint64_t white, char turn, int depth, int bulk, int threads, int64_t out[4]) {
+    PerftCounts total = {0};
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > 64) threads = 64;
+    if (depth <= 0) {
+        total.leaves = 1;
+    } else if (threads <= 1 || depth <= PERFT_SPLIT_PLIES) {
+        perft_count(black, white, turn, depth, bulk != 0, &total);
+    } else {
+        // The positions two plies down (256 from the empty board) are handed out one at
+        // a time, so threads that get small subtrees pick up more.
+        uint64_t frontier[256][2];
+        const int len = perft_frontier(black, white, turn, PERFT_SPLIT_PLIES, frontier, 0, &total);
+        int next = 0;
+        pthread_t tids[64];
+        bool started[64];
+        PerftJob jobs[64];
+        for (int t = 0; t < threads; t++) {
+            jobs[t] = (PerftJob){
+                .frontier = (const uint64_t (*)[2])frontier,
+                .len = len,
+                .next = &next,
+                .turn = turn,
+                .depth = depth - PERFT_SPLIT_PLIES,
+                .bulk = (bulk != 0),
+            };
+            started[t] = (t > 0) && pthread_create(&tids[t], NULL, perft_worker, &jobs[t]) == 0;
+        }
+        perft_worker(&jobs[0]);
+        for (int t = 0; t < threads; t++) {
+            if (t > 0 && started[t]) pthread_join(tids[t], NULL);
+            total.leaves += jobs[t].counts.leaves;
+            total.wins += jobs[t].counts.wins;
+            total.draws += jobs[t].counts.draws;
+            total.nodes += jobs[t].counts.nodes;
+        }
+    }
+    if (out) {
+        out[0] = total.leaves;
+        out[1] = total.wins;
+        out[2] = total.draws;
+        out[3] = total.nodes;
+    }
+    return total.leaves;
+}
+
+// Network input encoding: position i fills out[i * 128 .. i * 128 + 127], the first 64
+// values for the side to move and the next 64 for the opponent, in cell index order
+// (layer, row, column), i.e. a (2, 4, 4, 4) block per position.
+
+typedef struct {
+    int begin;
+    int end;
+    const uint64_t *black;
+    const uint64_t *white;
+    const char *turns;
+    float *out_f32;
+    uint8_t *out_u8;
+} EncodeJob;
+
+#define ENCODE_MIN_PER_THREAD 512
+
+static inline void encode_plane_f32(float *dst, uint64_t bits) {
+    for (int idx = 0; idx < 64; idx++) {
+        dst[idx] = (float)((bits >> (63 - idx)) & 1);
+    }
+}
+
+static inline void encode_plane_u8(uint8_t *dst, uint64_t bits) {
+    for (int idx = 0; idx < 64; idx++) {
+        dst[idx] = (uint8_t)((bits >> (63 - idx)) & 1);
+    }
+}
+
+static void *encode_range(void *arg) {
+    const EncodeJob *job = (const EncodeJob *)arg;
+    for (int i = job->begin; i < job->end; i++) {
+        const bool black_to_move = (job->turns[i] == 'b');
+        const uint64_t cur = black_to_move ? job->black[i] : job->white[i];
+        const uint64_t opp = black_to_move ? job->white[i] : job->black[i];
+        if (job->out_f32) {
+            encode_plane_f32(job->out_f32 + (size_t)i * 128, cur);
+            encode_plane_f32(job->out_f32 + (size_t)i * 128 + 64, opp);
+        } else {
+            encode_plane_u8(job->out_u8 + (size_t)i * 128, cur);
+            encode_plane_u8(job->out_u8 + (size_t)i * 128 + 64, opp);
+        }
+    }
+    return NULL;
+}
+
+// Splits [0, n) over up to `threads` threads (<= 0: online CPUs); the caller's thread
+// takes the first chunk. Falls back to fewer threads when thread creation fails.
+static void encode_batch(const EncodeJob *all, int n, int threads) {
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > n / ENCODE_MIN_PER_THREAD) threads = n / ENCODE_MIN_PER_THREAD;
+    if (threads > 64) threads = 64;
+    if (threads <= 1) {
+        EncodeJob job = *all;
+        job.begin = 0;
+        job.end = n;
+        encode_range(&job);
+        return;
+    }
+
+    pthread_t tids[64];
+    bool started[64];
+    EncodeJob jobs[64];
+    for (int t = 0; t < threads; t++) {
+        jobs[t] = *all;
+        jobs[t].begin = (int)((long long)n * t / threads);
+        jobs[t].end = (int)((long long)n * (t + 1) / threads);
+        started[t] = (t > 0) && pthread_create(&tids[t], NULL, encode_range, &jobs[t]) == 0;
+    }
+    encode_range(&jobs[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(tids[t], NULL);
+        } else {
+            encode_range(&jobs[t]);
+        }
+    }
+}
+
+void az_encode_batch(int n, const uint64_t *black, const uint64_t *white, const char *turns,
+                     float *out, int threads) {
+    const EncodeJob job = {0, n, black, white, turns, out, NULL};
+    encode_batch(&job, n, threads);
+}
+
+void az_encode_batch_u8(int n, const uint64_t *black, const uint64_t *white, const char *turns,
+                        uint8_t *out, int threads) {
+    const EncodeJob job = {0, n, black, white, turns, NULL, out};
+    encode_batch(&job, n, threads);
+}
+
+// Native PUCT search (AlphaZero-style MCTS). The tree lives here and Python only runs
+// the network: az_puct_select() walks down with virtual loss and writes the encoded
+// leaves that need an evaluation, az_puct_backup() takes the logits and values for
+// them, expands the leaves and backs the values up.
+
+#define PUCT_MAX_PLY 64
+
+enum { PUCT_UNEXPANDED = 0, PUCT_PENDING = 1, PUCT_EXPANDED = 2 };
+
+typedef struct {
+    int32_t n;                 // visits, including in-flight ones (virtual loss)
+    float w;                   // total value for the side to move at this node
+    float prior;               // prior of the move leading here
+    uint32_t first_child;      // children are contiguous: [first_child, first_child + child_count)
+    uint8_t move;              // cell index of the move leading here
+    uint8_t child_count;
+    uint8_t state;             // PUCT_UNEXPANDED / PUCT_PENDING / PUCT_EXPANDED
+    uint8_t pad;
+} PuctNode;
+
+// Keyed by the canonical form of the position (az_canonicalize), so symmetric positions
+// share one evaluation; priors follow the canonical position's legal moves.
+typedef struct {
+    uint64_t black;
+    uint64_t white;
+    float value;
+    uint8_t count;             // legal moves (0 = empty slot)
+    float priors[16];          // softmax over the legal moves, ascending index
+} PuctCacheEntry;
+
+typedef struct {
+    uint64_t black;
+    uint64_t white;
+    char turn;
+    int depth;
+    uint32_t path[PUCT_MAX_PLY + 1];
+} PuctLeaf;
+
+struct AzPuct {
+    PuctNode *nodes;
+    uint32_t capacity;
+    uint32_t count;
+    uint64_t black;            // root position
+    uint64_t white;
+    char turn;
+    float c_puct;
+    PuctCacheEntry *cache;
+    uint32_t cache_mask;
+    int64_t cache_hits;
+    int64_t cache_misses;
+    PuctLeaf *leaves;          // leaves handed out by the last az_puct_select()
+    int leaf_cap;
+    int leaf_count;
+};
+
+static inline void puct_reset(AzPuct *t, uint64_t black, uint64_t white, char turn) {
+    memset(&t->nodes[0], 0, sizeof(PuctNode));
+    t->count = 1;
+    t->black = black;
+    t->white = white;
+    t->turn = turn;
+    t->leaf_count = 0;
+}
+
+AzPuct *az_puct_new(int max_nodes, int cache_entries, float c_puct) {
+    AzPuct *t = (AzPuct *)calloc(1, sizeof(AzPuct));
+    if (!t) return NULL;
+    t->capacity = (uint32_t)((max_nodes > 1) ? max_nodes : 1);
+    t->nodes = (PuctNode *)malloc((size_t)t->capacity * sizeof(PuctNode));
+    if (cache_entries > 0) {
+        uint32_t size = 1;
+        while (size < (uint32_t)cache_entries && size < (UINT32_C(1) << 30)) size <<= 1;
+        t->cache = (PuctCacheEntry *)calloc(size, sizeof(PuctCacheEntry));
+        t->cache_mask = t->cache ? size - 1 : 0;
+    }
+    if (!t->nodes || (cache_entries > 0 && !t->cache)) {
+        az_puct_free(t);
+        return NULL;
+    }
+    t->c_puct = c_puct;
+    puct_reset(t, 0, 0, 'b');
+    return t;
+}
+
+void az_puct_free(AzPuct *t) {
+    if (!t) return;
+    free(t->nodes);
+    free(t->cache);
+    free(t->leaves);
+    free(t);
+}
+
+static inline PuctCacheEntry *puct_cache_slot(const AzPuct *t, uint64_t black, uint64_t white) {
+    if (!t->cache) return NULL;
+    const uint64_t h = (black * UINT64_C(0x9e3779b97f4a7c15)) ^ (white * UINT64_C(0xc2b2ae3d27d4eb4f));
+    return &t->cache[(uint32_t)(h >> 32) & t->cache_mask];
+}
+
+// Position of `index` among the moves in `moves` (ascending index order).
+static inline int move_rank(uint64_t moves, int index) {
+    return __builtin_popcountll(moves & ~(UINT64_MAX >> index));
+}
+
+// priors[i] for the i-th legal move of (black, white) <-> cache entry order: the i-th
+// move maps through `t` onto the canonical position, whose moves the entry follows.
+static void puct_cache_load(const PuctCacheEntry *e, int t, uint64_t black, uint64_t white, float *priors) {
+    const uint64_t canon_moves = get_possible_pos_board(e->black, e->white);
+    uint64_t moves = get_possible_pos_board(black, white);
+    for (int i = 0; moves != 0; i++) {
+        const int idx = bit_to_index(moves);
+        moves ^= index_to_bit(idx);
+        priors[i] = e->priors[move_rank(canon_moves, g_sym_cell[t][idx])];
+    }
+}
+
+static void puct_cache_store(PuctCacheEntry *e, int t, uint64_t canon_black, uint64_t canon_white,
+                             const uint64_t *moves, int count, const float *priors, float value) {
+    const uint64_t canon_moves = get_possible_pos_board(canon_black, canon_white);
+    e->black = canon_black;
+    e->white = canon_white;
+    e->value = value;
+    e->count = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+        e->priors[move_rank(canon_moves, g_sym_cell[t][bit_to_index(moves[i])])] = priors[i];
+    }
+}
+
+// Gives `idx` one child per legal move with the given priors. Leaves it unexpanded
+// when the pool is full.
+static void puct_expand(AzPuct *t, uint32_t idx, uint64_t black, uint64_t white, const float *priors) {
+    uint64_t moves[16];
+    const int count = get_possible_poses_binary(black, white, moves);
+    PuctNode *node = &t->nodes[idx];
+    if (count == 0 || t->count + (uint32_t)count > t->capacity) {
+        node->state = PUCT_UNEXPANDED;
+        return;
+    }
+    node->first_child = t->count;
+    node->child_count = (uint8_t)count;
+    for (int i = 0; i < count; i++) {
+        PuctNode *c = &t->nodes[t->count++];
+        memset(c, 0, sizeof(*c));
+        c->prior = priors[i];
+        c->move = (uint8_t)bit_to_index(moves[i]);
+    }
+    node->state = PUCT_EXPANDED;
+}
+
+// The walk down gave every node on the path one visit and +1 value (a loss as seen
+// from its parent); replace that with the real value, flipping sides at each ply.
+static void puct_backup_path(AzPuct *t, const uint32_t *path, int depth, float value) {
+    for (int d = depth; d >= 0; d--) {
+        t->nodes[path[d]].w += value - 1.0f;
+        value = -value;
+    }
+}
+
+static void puct_undo_path(AzPuct *t, const uint32_t *path, int depth) {
+    for (int d = depth; d >= 0; d--) {
+        t->nodes[path[d]].n -= 1;
+        t->nodes[path[d]].w -= 1.0f;
+    }
+}
+
+static inline uint32_t puct_select_child(const AzPuct *t, const PuctNode *node) {
+    // node->n already includes the visit walking through it right now.
+    const float sqrt_n = sqrtf((float)(node->n - 1) + 1e-8f);
+    uint32_t best = node->first_child;
+    float best_score = -1e9f;
+    for (uint32_t ci = node->first_child; ci < node->first_child + node->child_count; ci++) {
+        const PuctNode *c = &t->nodes[ci];
+        // Child values are from the child's side to move, so flip them for this node.
+        const float q = (c->n > 0) ? -c->w / (float)c->n : 0.0f;
+        const float score = q + t->c_puct * c->prior * sqrt_n / (1.0f + (float)c->n);
+        if (score > best_score) {
+            best_score = score;
+            best = ci;
+        }
+    }
+    return best;
+}
+
+int az_puct_set_root(AzPuct *t, uint64_t black, uint64_t white, char turn) {
+    if (t->black == black && t->white == white && t->turn == turn) return 1;
+    puct_reset(t, black, white, turn);
+    return 0;
+}
+
+void az_puct_reset(AzPuct *t, uint64_t black, uint64_t white, char turn) {
+    puct_reset(t, black, white, turn);
+}
+
+// Moves the root to its child for `action`, keeping that subtree compacted at the front
+// of the pool. Children are always allocated after their parent, so the kept nodes
+// move forward in index order and every child block stays contiguous.
+int az_puct_advance(AzPuct *t, int action) {
+    const uint64_t mv = index_to_bit(action);
+    uint64_t black = t->black;
+    uint64_t white = t->white;
+    if (t->turn == 'b') black |= mv; else white |= mv;
+    const char turn = (t->turn == 'b') ? 'w' : 'b';
+
+    const PuctNode *root = &t->nodes[0];
+    uint32_t new_root = 0;
+    if (root->state == PUCT_EXPANDED) {
+        for (uint32_t ci = root->first_child; ci < root->first_child + root->child_count; ci++) {
+            if (t->nodes[ci].move == (uint8_t)action) new_root = ci;
+        }
+    }
+    const uint32_t count = t->count;
+    uint32_t *remap = (new_root != 0) ? (uint32_t *)malloc((size_t)count * sizeof(uint32_t)) : NULL;
+    uint32_t *stack = (new_root != 0) ? (uint32_t *)malloc((size_t)count * sizeof(uint32_t)) : NULL;
+    if (!remap || !stack) {
+        free(remap);
+        free(stack);
+        puct_reset(t, black, white, turn);
+        return 0;
+    }
+
+    for (uint32_t i = new_root; i < count; i++) remap[i] = UINT32_MAX;
+    uint32_t sp = 0;
+    stack[sp++] = new_root;
+    while (sp > 0) {
+        const uint32_t i = stack[--sp];
+        const PuctNode *n = &t->nodes[i];
+        remap[i] = 0;
+        if (n->state != PUCT_EXPANDED) continue;
+        for (uint32_t ci = n->first_child; ci < n->first_child + n->child_count; ci++) {
+            stack[sp++] = ci;
+        }
+    }
+    free(stack);
+
+    uint32_t kept = 0;
+    for (uint32_t i = new_root; i < count; i++) {
+        if (remap[i] == UINT32_MAX) continue;
+        remap[i] = kept;
+        if (kept != i) t->nodes[kept] = t->nodes[i];
+        kept++;
+    }
+    for (uint32_t j = 0; j < kept; j++) {
+        PuctNode *n = &t->nodes[j];
+        if (n->state == PUCT_EXPANDED) n->first_child = remap[n->first_child];
+    }
+    free(remap);
+
+    t->count = kept;
+    t->black = black;
+    t->white = white;
+    t->turn = turn;
+    t->leaf_count = 0;
+    return 1;
+}
+
+int az_puct_select(AzPuct *t, int max_leaves, int max_sims, float *out_inputs, int32_t *out_sims) {
+    if (max_leaves > t->leaf_cap) {
+        PuctLeaf *leaves = (PuctLeaf *)realloc(t->leaves, (size_t)max_leaves * sizeof(PuctLeaf));
+        if (!leaves) max_leaves = t->leaf_cap;
+        else {
+            t->leaves = leaves;
+            t->leaf_cap = max_leaves;
+        }
+    }
+    t->leaf_count = 0;
+
+    int sims = 0;
+    bool collided = false;
+    while (!collided && t->leaf_count < max_leaves && sims < max_sims) {
+        PuctLeaf *leaf = &t->leaves[t->leaf_count];
+        uint64_t black = t->black;
+        uint64_t white = t->white;
+        char turn = t->turn;
+        int depth = 0;
+        leaf->path[0] = 0;
+        t->nodes[0].n += 1;
+        t->nodes[0].w += 1.0f;
+
+        while (1) {
+            PuctNode *node = &t->nodes[leaf->path[depth]];
+            const char res = which_is_win(black, white);
+            if (res != 'n') {
+                const float value = (res == 'd') ? 0.0f : ((res == turn) ? 1.0f : -1.0f);
+                puct_backup_path(t, leaf->path, depth, value);
+                sims++;
+                break;
+            }
+            if (node->state == PUCT_PENDING) {
+                // Already waiting for the network in this batch: end the batch here.
+                puct_undo_path(t, leaf->path, depth);
+                collided = true;
+                break;
+            }
+            if (node->state == PUCT_UNEXPANDED) {
+                uint64_t cb, cw;
+                const int sym = sym_canonicalize(black, white, &cb, &cw);
+                const PuctCacheEntry *e = puct_cache_slot(t, cb, cw);
+                if (e && e->count != 0 && e->black == cb && e->white == cw) {
+                    float priors[16];
+                    t->cache_hits++;
+                    puct_cache_load(e, sym, black, white, priors);
+                    puct_expand(t, leaf->path[depth], black, white, priors);
+                    puct_backup_path(t, leaf->path, depth, e->value);
+                } else {
+                    t->cache_misses++;
+                    node->state = PUCT_PENDING;
+                    leaf->black = black;
+                    leaf->white = white;
+                    leaf->turn = turn;
+                    leaf->depth = depth;
+                    EncodeJob job = {0, 1, &leaf->black, &leaf->white, &leaf->turn,
+                                           out_inputs + (size_t)t->leaf_count * 128, NULL};
+                    encode_range(&job);
+                    t->leaf_count++;
+                }
+                sims++;
+                break;
+            }
+
+            const uint32_t ci = puct_select_child(t, node);
+            PuctNode *c = &t->nodes[ci];
+            c->n += 1;
+            c->w += 1.0f;
+            const uint64_t mv = index_to_bit(c->move);
+            if (turn == 'b') black |= mv; else white |= mv;
+            turn = (turn == 'b') ? 'w' : 'b';
+            leaf->path[++depth] = ci;
+        }
+    }
+    if (out_sims) *out_sims = sims;
+    return t->leaf_count;
+}
+
+void az_puct_backup(AzPuct *t, const float *logits, const float *values) {
+    for (int i = 0; i < t->leaf_count; i++) {
+        const PuctLeaf *leaf = &t->leaves[i];
+        const float *lg = logits + (size_t)i * 64;
+        uint64_t moves[16];
+        const int count = get_possible_poses_binary(leaf->black, leaf->white, moves);
+        float priors[16];
+        float max_logit = -1e30f;
+        for (int m = 0; m < count; m++) {
+            const float x = lg[bit_to_index(moves[m])];
+            if (x > max_logit) max_logit = x;
+        }
+        float sum = 0.0f;
+        for (int m = 0; m < count; m++) {
+            priors[m] = expf(lg[bit_to_index(moves[m])] - max_logit);
+            sum += priors[m];
+        }
+        for (int m = 0; m < count; m++) priors[m] /= sum;
+
+        uint64_t cb, cw;
+        const int sym = sym_canonicalize(leaf->black, leaf->white, &cb, &cw);
+        PuctCacheEntry *e = puct_cache_slot(t, cb, cw);
+        if (e) puct_cache_store(e, sym, cb, cw, moves, count, priors, values[i]);
+        puct_expand(t, leaf->path[leaf->depth], leaf->black, leaf->white, priors);
+        puct_backup_path(t, leaf->path, leaf->depth, values[i]);
+    }
+    t->leaf_count = 0;
+}
+
+int az_puct_root_children(const AzPuct *t, int32_t *out_moves, int32_t *out_visits) {
+    const PuctNode *root = &t->nodes[0];
+    if (root->state != PUCT_EXPANDED) return 0;
+    for (int i = 0; i < root->child_count; i++) {
+        const PuctNode *c = &t->nodes[root->first_child + (uint32_t)i];
+        if (out_moves) out_moves[i] = c->move;
+        if (out_visits) out_visits[i] = c->n;
+    }
+    return root->child_count;
+}
+
+void az_puct_add_root_noise(AzPuct *t, const float *noise, float eps) {
+    const PuctNode *root = &t->nodes[0];
+    if (root->state != PUCT_EXPANDED) return;
+    for (int i = 0; i < root->child_count; i++) {
+        PuctNode *c = &t->nodes[root->first_child + (uint32_t)i];
+        c->prior = (1.0f - eps) * c->prior + eps * noise[i];
+    }
+}
+
+void az_puct_policy(const AzPuct *t, float temperature, float *out) {
+    memset(out, 0, 64 * sizeof(float));
+    const PuctNode *root = &t->nodes[0];
+    if (root->state == PUCT_EXPANDED) {
+        for (uint32_t ci = root->first_child; ci < root->first_child + root->child_count; ci++) {
+            out[t->nodes[ci].move] = (float)t->nodes[ci].n;
+        }
+    }
+    if (temperature <= 0.0f) {
+        int best = 0;
+        for (int a = 1; a < 64; a++) {
+            if (out[a] > out[best]) best = a;
+        }
+        memset(out, 0, 64 * sizeof(float));
+        out[best] = 1.0f;
+        return;
+    }
+    float total = 0.0f;
+    for (int a = 0; a < 64; a++) {
+        if (temperature != 1.0f && out[a] > 0.0f) out[a] = powf(out[a], 1.0f / temperature);
+        total += out[a];
+    }
+    for (int a = 0; a < 64; a++) {
+        out[a] = (total > 0.0f) ? out[a] / total : 1.0f / 64.0f;
+    }
+}
+
+void az_puct_stats(const AzPuct *t, int64_t out[3]) {
+    out[0] = t->cache_hits;
+    out[1] = t->cache_misses;
+    out[2] = t->count;
+}
@@ -13,9 +13,16 @@ void az_init(void);
 // Returns number of legal moves. out_moves must have capacity 16.
 int az_legal_moves(uint64_t black, uint64_t white, uint64_t out_moves[16]);
 
+// Returns all legal moves as one bitboard (one bit per move, index 0 = MSB).
+uint64_t az_legal_mask(uint64_t black, uint64_t white);
+
 // Returns 'b', 'w', 'd', or 'n' (ongoing).
 char az_result(uint64_t black, uint64_t white);
 
+// Legal moves that win on the spot for `turn` (one bit per move), from the same
+// shift-based threat scan the CLI search uses.
+uint64_t az_winning_moves(uint64_t black, uint64_t white, char turn);
+
 // Apply move (bitboard) for turn ('b' or 'w'), output new boards.
 void az_apply_move(uint64_t black, uint64_t white, char turn, uint64_t move,
                    uint64_t *out_black, uint64_t *out_white);
@@ -24,6 +31,72 @@ void az_apply_move(uint64_t black, uint64_t white, char turn, uint64_t move,
 int az_move_index(uint64_t move);
 uint64_t az_move_bit(int index);
 
+// Batched variants over n positions stored as contiguous arrays (black[i], white[i], turns[i]).
+// Outputs are caller-provided arrays of length n; inputs and outputs may alias.
+void az_legal_mask_batch(int n, const uint64_t *black, const uint64_t *white, uint64_t *out_masks);
+void az_result_batch(int n, const uint64_t *black, const uint64_t *white, char *out_results);
+// moves[i] is a move index (0-63); an out-of-range index leaves the position unchanged.
+void az_apply_move_batch(int n, const uint64_t *black, const uint64_t *white, const char *turns,
+                         const int32_t *moves, uint64_t *out_black, uint64_t *out_white);
+
+// Perft: counts the positions exactly `depth` plies ahead (games that end earlier stop
+// there). out = {leaves, wins, draws, nodes}, where wins/draws count the games ending
+// within `depth` plies. `bulk` counts the last ply from the move list without playing
+// it; threads <= 0 uses all online CPUs. Returns the leaf count.
+int64_t az_perft(uint64_t black, uint64_t white, char turn, int depth, int bulk, int threads, int64_t out[4]);
+
+// Network input for n positions from the side to move's perspective: position i writes
+// out[i*128 .. i*128+127] as a (2, 4, 4, 4) block (plane 0 = side to move, plane 1 =
+// opponent; cells in index order). threads <= 0 uses all online CPUs; small batches
+// are encoded on the calling thread.
+void az_encode_batch(int n, const uint64_t *black, const uint64_t *white, const char *turns,
+                     float *out, int threads);
+void az_encode_batch_u8(int n, const uint64_t *black, const uint64_t *white, const char *turns,
+                        uint8_t *out, int threads);
+
+// Board symmetries that keep gravity: the 8 symmetries of the square applied to every
+// layer (transform 0 is the identity). Moves are cell indices 0-63.
+#define AZ_SYM_COUNT 8
+uint64_t az_sym_board(uint64_t board, int transform);
+int az_sym_move(int index, int transform);
+int az_sym_inverse(int transform);
+// Canonical form: the image of (black, white) that is smallest as a (black, white) pair.
+// Returns the transform t with out = az_sym_board(in, t); symmetric positions share it.
+int az_canonicalize(uint64_t black, uint64_t white, uint64_t *out_black, uint64_t *out_white);
+void az_canonicalize_batch(int n, const uint64_t *black, const uint64_t *white,
+                           uint64_t *out_black, uint64_t *out_white, uint8_t *out_transforms);
+
+// Native PUCT search. The engine owns the tree and Python evaluates leaf batches:
+//   az_puct_set_root(t, ...)                   // keeps the tree if it is already rooted there
+//   while sims < budget:
+//       n = az_puct_select(t, batch, budget - sims, inputs, &done)   // inputs: n x 128 floats
+//       sims += done
+//       if n > 0: az_puct_backup(t, logits /* n x 64 */, values /* n */)
+//   az_puct_policy(t, temperature, policy)
+// Leaves are collected with virtual loss; terminal positions and cached evaluations
+// are backed up inside az_puct_select() and count toward `done`.
+typedef struct AzPuct AzPuct;
+
+// Returns NULL on allocation failure. cache_entries <= 0 disables the evaluation cache.
+AzPuct *az_puct_new(int max_nodes, int cache_entries, float c_puct);
+void az_puct_free(AzPuct *t);
+// Returns 1 if the tree was already rooted at this position (kept), 0 if it was reset.
+int az_puct_set_root(AzPuct *t, uint64_t black, uint64_t white, char turn);
+// Drops the whole tree and roots it at this position; the evaluation cache is kept.
+void az_puct_reset(AzPuct *t, uint64_t black, uint64_t white, char turn);
+// Plays `action` (index 0-63) at the root; returns 1 if its subtree was kept.
+int az_puct_advance(AzPuct *t, int action);
+int az_puct_select(AzPuct *t, int max_leaves, int max_sims, float *out_inputs, int32_t *out_sims);
+void az_puct_backup(AzPuct *t, const float *logits, const float *values);
+// Root children (ascending move index); returns their count, 0 while the root is unexpanded.
+int az_puct_root_children(const AzPuct *t, int32_t *out_moves, int32_t *out_visits);
+// Mixes noise[i] (one per root child) into the root priors: p = (1 - eps) * p + eps * noise.
+void az_puct_add_root_noise(AzPuct *t, const float *noise, float eps);
+// Visit-count policy over the 64 cells; temperature <= 0 gives a one-hot argmax.
+void az_puct_policy(const AzPuct *t, float temperature, float *out);
+// out = {cache hits, cache misses, nodes in use}.
+void az_puct_stats(const AzPuct *t, int64_t out[3]);
+
 #ifdef __cplusplus
 }
 #endif
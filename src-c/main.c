@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdarg.h>
 #include <inttypes.h>
 #include <time.h>
 #include <unistd.h>
@@ -10,9 +11,24 @@
 #include <math.h>
 #include <limits.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "board.h"
 
 typedef unsigned long ulong;
+// ulong boards go straight into the shared core's uint64_t helpers.
+_Static_assert(sizeof(ulong) == sizeof(uint64_t), "ulong must be 64 bits");
 
 ulong decimal2binary(int decimal_num);
 int binary2decimal(ulong binary_num);
@@ -92,143 +108,12 @@ static uint64_t auto_seed64(void) {
     return splitmix64_next(&x);
 }
 
-const ulong conditions[76] = {
-    0b1111000000000000000000000000000000000000000000000000000000000000,
-    0b0000111100000000000000000000000000000000000000000000000000000000,
-    0b0000000011110000000000000000000000000000000000000000000000000000,
-    0b0000000000001111000000000000000000000000000000000000000000000000,
-    0b0000000000000000111100000000000000000000000000000000000000000000,
-    0b0000000000000000000011110000000000000000000000000000000000000000,
-    0b0000000000000000000000001111000000000000000000000000000000000000,
-    0b0000000000000000000000000000111100000000000000000000000000000000,
-    0b0000000000000000000000000000000011110000000000000000000000000000,
-    0b0000000000000000000000000000000000001111000000000000000000000000,
-    0b0000000000000000000000000000000000000000111100000000000000000000,
-    0b0000000000000000000000000000000000000000000011110000000000000000,
-    0b0000000000000000000000000000000000000000000000001111000000000000,
-    0b0000000000000000000000000000000000000000000000000000111100000000,
-    0b0000000000000000000000000000000000000000000000000000000011110000,
-    0b0000000000000000000000000000000000000000000000000000000000001111,
-    0b1000100010001000000000000000000000000000000000000000000000000000,
-    0b0100010001000100000000000000000000000000000000000000000000000000,
-    0b0010001000100010000000000000000000000000000000000000000000000000,
-    0b0001000100010001000000000000000000000000000000000000000000000000,
-    0b0000000000000000100010001000100000000000000000000000000000000000,
-    0b0000000000000000010001000100010000000000000000000000000000000000,
-    0b0000000000000000001000100010001000000000000000000000000000000000,
-    0b0000000000000000000100010001000100000000000000000000000000000000,
-    0b0000000000000000000000000000000010001000100010000000000000000000,
-    0b0000000000000000000000000000000001000100010001000000000000000000,
-    0b0000000000000000000000000000000000100010001000100000000000000000,
-    0b0000000000000000000000000000000000010001000100010000000000000000,
-    0b0000000000000000000000000000000000000000000000001000100010001000,
-    0b0000000000000000000000000000000000000000000000000100010001000100,
-    0b0000000000000000000000000000000000000000000000000010001000100010,
-    0b0000000000000000000000000000000000000000000000000001000100010001,
-    0b1000000000000000100000000000000010000000000000001000000000000000,
-    0b0100000000000000010000000000000001000000000000000100000000000000,
-    0b0010000000000000001000000000000000100000000000000010000000000000,
-    0b0001000000000000000100000000000000010000000000000001000000000000,
-    0b0000100000000000000010000000000000001000000000000000100000000000,
-    0b0000010000000000000001000000000000000100000000000000010000000000,
-    0b0000001000000000000000100000000000000010000000000000001000000000,
-    0b0000000100000000000000010000000000000001000000000000000100000000,
-    0b0000000010000000000000001000000000000000100000000000000010000000,
-    0b0000000001000000000000000100000000000000010000000000000001000000,
-    0b0000000000100000000000000010000000000000001000000000000000100000,
-    0b0000000000010000000000000001000000000000000100000000000000010000,
-    0b0000000000001000000000000000100000000000000010000000000000001000,
-    0b0000000000000100000000000000010000000000000001000000000000000100,
-    0b0000000000000010000000000000001000000000000000100000000000000010,
-    0b0000000000000001000000000000000100000000000000010000000000000001,
-    0b1000010000100001000000000000000000000000000000000000000000000000,
-    0b0000000000000000100001000010000100000000000000000000000000000000,
-    0b0000000000000000000000000000000010000100001000010000000000000000,
-    0b0000000000000000000000000000000000000000000000001000010000100001,
-    0b0001001001001000000000000000000000000000000000000000000000000000,
-    0b0000000000000000000100100100100000000000000000000000000000000000,
-    0b0000000000000000000000000000000000010010010010000000000000000000,
-    0b0000000000000000000000000000000000000000000000000001001001001000,
-    0b0001000000000000001000000000000001000000000000001000000000000000,
-    0b0000000100000000000000100000000000000100000000000000100000000000,
-    0b0000000000010000000000000010000000000000010000000000000010000000,
-    0b0000000000000001000000000000001000000000000001000000000000001000,
-    0b1000000000000000010000000000000000100000000000000001000000000000,
-    0b0000100000000000000001000000000000000010000000000000000100000000,
-    0b0000000010000000000000000100000000000000000100000000000000010000,
-    0b0000000000001000000000000000010000000000000000010000000000000001,
-    0b1000000000000000000010000000000000000000100000000000000000001000,
-    0b0100000000000000000001000000000000000000010000000000000000000100,
-    0b0010000000000000000000100000000000000000001000000000000000000010,
-    0b0001000000000000000000010000000000000000000100000000000000000001,
-    0b0000000000001000000000001000000000001000000000001000000000000000,
-    0b0000000000000100000000000100000000000100000000000100000000000000,
-    0b0000000000000010000000000010000000000010000000000010000000000000,
-    0b0000000000000001000000000001000000000001000000000001000000000000,
-    0b0000000000000001000000000010000000000100000000001000000000000000,
-    0b1000000000000000000001000000000000000000001000000000000000000001,
-    0b0001000000000000000000100000000000000000100000000000000000001000,
-    0b0000000000001000000000000100000000000010000000000001000000000000
-};
-
-// For fast "did the last move win?" checks in rollouts/expansions.
-#define MAX_CELL_LINES 16
-static uint8_t g_cell_lines_count[64];
-static ulong g_cell_lines[64][MAX_CELL_LINES];
-
-static void init_cell_lines(void) {
-    memset(g_cell_lines_count, 0, sizeof(g_cell_lines_count));
-    const ulong top_bit = (ulong)UINT64_C(0x8000000000000000);
-    for (int li = 0; li < 76; li++) {
-        const ulong mask = conditions[li];
-        for (int idx = 0; idx < 64; idx++) {
-            const ulong bit = top_bit >> idx;
-            if ((mask & bit) == 0) continue;
-            uint8_t n = g_cell_lines_count[idx];
-            if (n < MAX_CELL_LINES) {
-                g_cell_lines[idx][n] = mask;
-                g_cell_lines_count[idx] = (uint8_t)(n + 1);
-            }
-        }
-    }
-}
-
-static inline bool is_win_after_move(const ulong player_board_after, const ulong last_move_bit) {
-    const int idx = binary2decimal(last_move_bit);
-    if (idx < 0 || idx >= 64) return false;
-    const uint8_t n = g_cell_lines_count[idx];
-    for (uint8_t i = 0; i < n; i++) {
-        const ulong mask = g_cell_lines[idx][i];
-        if ((player_board_after & mask) == mask) {
-            return true;
-        }
-    }
-    return false;
-}
-
 ulong decimal2binary(int decimal_num) {
-    if (decimal_num < 0 || decimal_num >= 64) {
-        return 0;
-    }
-    return (ulong)UINT64_C(0x8000000000000000) >> (unsigned)decimal_num;
+    return index_to_bit(decimal_num);
 }
 
 int binary2decimal(ulong binary_num) {
-    if (binary_num == 0) {
-        return -1;
-    }
-#if ULONG_MAX == 0xffffffffffffffffUL
-    return (int)__builtin_clzl(binary_num);
-#else
-    // Fallback: shift until MSB.
-    int x = 0;
-    ulong msb = (ulong)1 << ((int)(sizeof(ulong) * 8) - 1);
-    while ((binary_num & msb) == 0) {
-        binary_num <<= 1;
-        x++;
-    }
-    return x;
-#endif
+    return bit_to_index(binary_num);
 }
 
 void binary2arrayboard(ulong binary, signed char board[64]) {
@@ -248,43 +133,21 @@ char convert_turn(char turn) {
     }
 }
 
-ulong get_possible_pos_board(const ulong black_board, const ulong white_board) {
-    ulong board = black_board | white_board;
-    ulong first_floor = 0b1111111111111111000000000000000000000000000000000000000000000000;
-    return ((board >> 16) ^ board) ^ first_floor;
-}
-
 bool is_possible_pos(const ulong black_board, const ulong white_board, const ulong index) {
     return 0 < (get_possible_pos_board(black_board, white_board) & index);
 }
 
-int get_possible_poses_binary(const ulong black_board, const ulong white_board, ulong array[16]) {
-    ulong board = 0b1000000000000000000000000000000000000000000000000000000000000000;
-    ulong possible_pos_board = get_possible_pos_board(black_board, white_board);
-    int array_index = 0;
-    for (int i=0; i<64; i++) {
-        if ((possible_pos_board & (board >> i)) != 0) {
-            array[array_index] = board >> i;
-            array_index++;
-        }
-    }
-    return array_index;
-}
-
-char which_is_win(const ulong black_board, const ulong white_board) {
-    for (int i=0; i<76; i++) {
-        const ulong cond = conditions[i];
-        if ((black_board & cond) == cond) {
-            return 'b';
-        } else if ((white_board & cond) == cond) {
-            return 'w';
-        }
-    }
-    if (get_possible_pos_board(black_board, white_board) == 0) {
-        return 'd';
+// The n-th move (0-based, index order) of a non-empty mask.
+static inline ulong nth_move(ulong moves, uint32_t n) {
+    const int k = count_moves(moves) - 1 - (int)n;   // n-th from the top is k-th from the bottom
+#ifdef __BMI2__
+    return (ulong)_pdep_u64(UINT64_C(1) << k, moves);
+#else
+    for (int i = 0; i < k; i++) {
+        moves &= moves - 1;
     }
-
-    return 'n';
+    return moves & (~moves + 1);
+#endif
 }
 
 void print_board(const ulong black_board, const ulong white_board) {
@@ -326,12 +189,11 @@ ulong human_act(const ulong black_board, const ulong white_board) {
 }
 
 ulong random_act(const ulong black_board, const ulong white_board, Rng *rng) {
-    ulong possible_poses[16];
-    int possible_poses_len = get_possible_poses_binary(black_board, white_board, possible_poses);
-    if (possible_poses_len <= 0) {
+    const ulong possible = get_possible_pos_board(black_board, white_board);
+    if (possible == 0) {
         return 0;
     }
-    return possible_poses[(int)rng_uniform_u32(rng, (uint32_t)possible_poses_len)];
+    return nth_move(possible, rng_uniform_u32(rng, (uint32_t)count_moves(possible)));
 }
 
 int max_index(int nums[], int n) {
@@ -381,43 +243,377 @@ int get_score(const ulong black_board, const ulong white_board, char my_turn) {
     } else if (res == 'd') {
         score =  0;
     } else {
-        if (my_turn == 'b') {
-            for (int i=0; i<76; i++) {
-                if (((black_board & conditions[i]) > 0) && ((white_board & conditions[i]) == 0)) {
-                    score++;
-                } else if (((black_board & conditions[i]) == 0) && ((white_board & conditions[i]) > 0)) {
-                    score--;
-                }
-            }
-        } else {
-            for (int i=0; i<76; i++) {
-                if (((black_board & conditions[i]) > 0) && ((white_board & conditions[i]) == 0)) {
-                    score--;
-                } else if (((black_board & conditions[i]) == 0) && ((white_board & conditions[i]) > 0)) {
-                    score++;
-                }
-            }
-        }
+        const int diff = line_diff(black_board, white_board);
+        score = (my_turn == 'b') ? diff : -diff;
     }
 
     return score;
 }
 
-int alphabeta(const ulong black_board, const ulong white_board, int depth, int alpha, int beta,
-                char turn, char my_turn) {
-    if (depth == 0 || which_is_win(black_board, white_board) != 'n') {
-        return get_score(black_board, white_board, my_turn);
+// ----------------------------
+// Incremental line evaluation
+// ----------------------------
+// Mirrors get_score() but keeps per-line piece counts, so a move only touches the lines
+// through its cell (g_cell_line_ids) instead of rescanning all 76 conditions.
+typedef struct {
+    uint8_t count[2][76];      // pieces per line: [0] black, [1] white
+    int open_diff;             // black-only lines minus white-only lines
+    int pieces;
+    uint8_t wins[2];           // completed lines per side
+} LineEval;
+
+static inline int side_index(char turn) {
+    return (turn == 'b') ? 0 : 1;
+}
+
+static inline void line_eval_make(LineEval *ev, int side, int cell) {
+    const int sign = (side == 0) ? 1 : -1;
+    const uint8_t n = g_cell_lines_count[cell];
+    for (uint8_t i = 0; i < n; i++) {
+        const uint8_t li = g_cell_line_ids[cell][i];
+        if (ev->count[side][li] == 0) {
+            // Empty -> ours, or theirs -> dead: both move the difference our way.
+            ev->open_diff += sign;
+        }
+        if (++ev->count[side][li] == 4) {
+            ev->wins[side]++;
+        }
+    }
+    ev->pieces++;
+}
+
+static inline void line_eval_unmake(LineEval *ev, int side, int cell) {
+    const int sign = (side == 0) ? 1 : -1;
+    const uint8_t n = g_cell_lines_count[cell];
+    for (uint8_t i = 0; i < n; i++) {
+        const uint8_t li = g_cell_line_ids[cell][i];
+        if (ev->count[side][li]-- == 4) {
+            ev->wins[side]--;
+        }
+        if (ev->count[side][li] == 0) {
+            ev->open_diff -= sign;
+        }
+    }
+    ev->pieces--;
+}
+
+static void line_eval_init(LineEval *ev, const ulong black_board, const ulong white_board) {
+    memset(ev, 0, sizeof(*ev));
+    for (int idx = 0; idx < 64; idx++) {
+        const ulong bit = decimal2binary(idx);
+        if (black_board & bit) {
+            line_eval_make(ev, 0, idx);
+        } else if (white_board & bit) {
+            line_eval_make(ev, 1, idx);
+        }
+    }
+}
+
+static inline char line_eval_result(const LineEval *ev) {
+    if (ev->wins[0] > 0) return 'b';
+    if (ev->wins[1] > 0) return 'w';
+    if (ev->pieces == 64) return 'd';
+    return 'n';
+}
+
+// Same value as get_score(black_board, white_board, my_turn) for the tracked position.
+static inline int line_eval_score(const LineEval *ev, char my_turn) {
+    const char res = line_eval_result(ev);
+    if (res == 'n') {
+        return (my_turn == 'b') ? ev->open_diff : -ev->open_diff;
+    }
+    if (res == 'd') return 0;
+    return (res == my_turn) ? 100 : -100;
+}
+
+// ----------------------------
+// Transposition table (shared, lock-free)
+// ----------------------------
+// The (black, white) pair is the whole position, so the key is a mix of the two
+// bitboards instead of a Zobrist hash. Each slot keeps key^data next to data; a slot
+// torn by a concurrent writer fails the check and reads as a miss (Hyatt & Mann, 2002).
+enum {
+    TT_BOUND_NONE = 0,
+    TT_BOUND_EXACT = 1,
+    TT_BOUND_LOWER = 2,
+    TT_BOUND_UPPER = 3,
+};
+
+typedef struct {
+    uint64_t check;            // key ^ data
+    uint64_t data;             // score:16 depth:8 bound:8 move:8 generation:8
+} TTEntry;
+
+typedef struct {
+    int score;                 // from the side to move's perspective
+    int depth;
+    int bound;
+    int move;                  // 0-63, or -1 if unknown
+} TTHit;
+
+typedef struct {
+    long long hits;
+    long long misses;
+    long long collisions;      // slot held a different position
+} TTStats;
+
+typedef struct {
+    TTEntry *entries;
+    uint64_t mask;
+    size_t bytes;
+    uint8_t generation;        // bumped atomically by every search; see tt_new_search()
+} TransTable;
+
+static TransTable g_tt = {0};
+static _Thread_local TTStats t_tt_stats;
+
+static inline uint64_t tt_key(const ulong black_board, const ulong white_board) {
+    uint64_t x = (uint64_t)black_board * UINT64_C(0x9e3779b97f4a7c15);
+    x ^= rotl64((uint64_t)white_board, 32) * UINT64_C(0xc2b2ae3d27d4eb4f);
+    x ^= x >> 31;
+    x *= UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 29;
+    return x;
+}
+
+// The minimax table is keyed by the canonical image of a position (sym_canonicalize), so
+// the up to 8 symmetric copies of a position share one entry. Moves are stored in the
+// canonical frame; `sym` is the transform from the caller's frame into it.
+typedef struct {
+    uint64_t key;
+    int sym;
+} TTPos;
+
+static inline TTPos tt_pos(const ulong black_board, const ulong white_board) {
+    ulong cb, cw;
+    const int sym = sym_canonicalize(black_board, white_board, &cb, &cw);
+    return (TTPos){tt_key(cb, cw), sym};
+}
+
+static inline uint64_t tt_pack(int score, int depth, int bound, int move, uint8_t generation) {
+    return (uint64_t)(uint16_t)(int16_t)score
+        | ((uint64_t)(uint8_t)depth << 16)
+        | ((uint64_t)(uint8_t)bound << 24)
+        | ((uint64_t)(uint8_t)((move < 0) ? 0xff : move) << 32)
+        | ((uint64_t)generation << 40);
+}
+
+static bool tt_init(long long megabytes) {
+    free(g_tt.entries);
+    memset(&g_tt, 0, sizeof(g_tt));
+    if (megabytes <= 0) return true;
+
+    uint64_t n = 1;
+    const uint64_t want = ((uint64_t)megabytes << 20) / sizeof(TTEntry);
+    while ((n << 1) <= want) n <<= 1;
+    while (n >= 1024) {
+        g_tt.entries = (TTEntry*)calloc((size_t)n, sizeof(TTEntry));
+        if (g_tt.entries) break;
+        n >>= 1;
+    }
+    if (!g_tt.entries) return false;
+    g_tt.mask = n - 1;
+    g_tt.bytes = (size_t)n * sizeof(TTEntry);
+    return true;
+}
+
+// Forgets every stored position, e.g. between independent games.
+static void tt_clear(void) {
+    if (g_tt.entries) memset(g_tt.entries, 0, g_tt.bytes);
+}
+
+// Starts a new search generation and returns it. Searches may run concurrently on the
+// shared table, so each reads its generation here once and passes it to tt_store().
+static inline uint8_t tt_new_search(void) {
+    return __atomic_add_fetch(&g_tt.generation, 1, __ATOMIC_RELAXED);
+}
+
+static inline bool tt_probe(const TTPos pos, TTHit *hit) {
+    if (!g_tt.entries) return false;
+    const uint64_t key = pos.key;
+    TTEntry *e = &g_tt.entries[key & g_tt.mask];
+    const uint64_t data = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+    const uint64_t check = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+    if (data == 0) {
+        t_tt_stats.misses++;
+        return false;
+    }
+    if ((check ^ data) != key) {
+        t_tt_stats.misses++;
+        t_tt_stats.collisions++;
+        return false;
+    }
+    t_tt_stats.hits++;
+    hit->score = (int)(int16_t)(uint16_t)(data & 0xffff);
+    hit->depth = (int)((data >> 16) & 0xff);
+    hit->bound = (int)((data >> 24) & 0xff);
+    const int move = (int)((data >> 32) & 0xff);
+    hit->move = (move == 0xff) ? -1 : g_sym_cell[g_sym_inverse[pos.sym]][move];
+    return true;
+}
+
+static inline void tt_store(const TTPos pos, uint8_t generation, int depth, int bound, int score, int move) {
+    if (!g_tt.entries) return;
+    const uint64_t key = pos.key;
+    if (move >= 0) move = g_sym_cell[pos.sym][move];
+    TTEntry *e = &g_tt.entries[key & g_tt.mask];
+    const uint64_t old = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+    if (old != 0) {
+        const bool same = ((__atomic_load_n(&e->check, __ATOMIC_RELAXED) ^ old) == key);
+        const int old_depth = (int)((old >> 16) & 0xff);
+        const bool stale = ((uint8_t)(old >> 40) != generation);
+        // Depth-preferred within a search, but never let old searches pin a slot.
+        if (!stale && depth < old_depth && !(same && bound == TT_BOUND_EXACT)) return;
+        if (same && move < 0) {
+            const int old_move = (int)((old >> 32) & 0xff);
+            move = (old_move == 0xff) ? -1 : old_move;
+        }
+    }
+    const uint64_t data = tt_pack(score, depth, bound, move, generation);
+    __atomic_store_n(&e->data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->check, key ^ data, __ATOMIC_RELAXED);
+}
+
+// Fold this thread's counters into the totals of its search.
+static inline void tt_flush_stats(TTStats *into) {
+    #pragma omp atomic
+    into->hits += t_tt_stats.hits;
+    #pragma omp atomic
+    into->misses += t_tt_stats.misses;
+    #pragma omp atomic
+    into->collisions += t_tt_stats.collisions;
+    memset(&t_tt_stats, 0, sizeof(t_tt_stats));
+}
+
+// Scores in alphabeta() are from my_turn's perspective; the table stores them from the
+// side to move's, so one entry serves both players.
+static inline int tt_flip_bound(int bound) {
+    if (bound == TT_BOUND_LOWER) return TT_BOUND_UPPER;
+    if (bound == TT_BOUND_UPPER) return TT_BOUND_LOWER;
+    return bound;
+}
+
+// ----------------------------
+// Minimax (YBWC parallel alpha-beta)
+// ----------------------------
+typedef struct {
+    int depth;                 // <=0: no depth limit (requires time_ms > 0)
+    int time_ms;               // <=0: no time limit
+    int threads;               // <=0: omp_get_max_threads()
+    int verbose;               // 0: quiet, >=1: per-move search output
+    const int *stop;           // non-NULL: iterate, and end early once *stop is set
+    // Called after every finished iterative-deepening iteration (NULL: none).
+    void (*on_iteration)(void *arg, int depth, int score, int move, long long nodes, double seconds);
+    void *on_iteration_arg;
+    long long *nodes;          // non-NULL: receives the node count of the search
+} MinimaxConfig;
+
+// State of one minimax search. Only the transposition table is shared between searches,
+// so several can run at once (e.g. one per server session). Every thread of the search's
+// OpenMP team points t_search at it on entry to minmax_root().
+// An iterative-deepening iteration that runs past the deadline (or is stopped from
+// outside) is abandoned: every alphabeta() frame sees `stop` and unwinds without
+// touching the table.
+typedef struct {
+    double deadline;           // omp_get_wtime() deadline (<=0: none)
+    const int *abort;          // external stop request (NULL: none)
+    int stop;
+    long long nodes;
+    uint8_t generation;        // from tt_new_search()
+    TTStats tt;
+} SearchCtx;
+
+static _Thread_local SearchCtx *t_search = NULL;
+static _Thread_local unsigned long long t_search_nodes = 0;
+
+static inline bool search_stopped(void) {
+    return __atomic_load_n(&t_search->stop, __ATOMIC_RELAXED) != 0;
+}
+
+static inline bool search_should_stop(void) {
+    if (search_stopped()) return true;
+    const SearchCtx *ctx = t_search;
+    if (ctx->deadline <= 0.0 && !ctx->abort) return false;
+    if ((t_search_nodes & 0x3ff) != 0) return false;
+    const bool aborted = ctx->abort && __atomic_load_n(ctx->abort, __ATOMIC_RELAXED) != 0;
+    if (!aborted && (ctx->deadline <= 0.0 || omp_get_wtime() < ctx->deadline)) return false;
+    __atomic_store_n(&t_search->stop, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+// Fold this thread's node count into the search total.
+static inline void search_flush_nodes(void) {
+    #pragma omp atomic
+    t_search->nodes += (long long)t_search_nodes;
+    t_search_nodes = 0;
+}
+
+// Young Brothers Wait (Feldmann, 1993): a node searches its eldest child alone, then
+// hands the younger siblings to OpenMP tasks that share the node's window. A sibling
+// that fails high sets `cutoff`, which every task below the split point polls.
+#define YBW_MIN_DEPTH 3
+
+typedef struct SplitPoint {
+    const struct SplitPoint *parent;
+    int cutoff;
+} SplitPoint;
+
+static inline bool split_aborted(const SplitPoint *sp) {
+    for (; sp != NULL; sp = sp->parent) {
+        if (__atomic_load_n(&sp->cutoff, __ATOMIC_RELAXED)) return true;
+    }
+    return false;
+}
+
+// ev tracks (black_board, white_board) on entry and is restored before returning.
+int alphabeta(const ulong black_board, const ulong white_board, LineEval *ev, int depth, int alpha, int beta,
+                char turn, char my_turn, const SplitPoint *sp) {
+    t_search_nodes++;
+    if (search_should_stop() || split_aborted(sp)) {
+        return 0;
+    }
+    if (depth == 0 || line_eval_result(ev) != 'n') {
+        return line_eval_score(ev, my_turn);
+    }
+
+    const bool flip = (turn != my_turn);
+    const TTPos key = tt_pos(black_board, white_board);
+    int tt_move = -1;
+    TTHit hit;
+    if (tt_probe(key, &hit)) {
+        tt_move = hit.move;
+        if (hit.depth >= depth) {
+            const int tt_score = flip ? -hit.score : hit.score;
+            const int bound = flip ? tt_flip_bound(hit.bound) : hit.bound;
+            if (bound == TT_BOUND_EXACT) {
+                return tt_score;
+            } else if (bound == TT_BOUND_LOWER && tt_score > alpha) {
+                alpha = tt_score;
+            } else if (bound == TT_BOUND_UPPER && tt_score < beta) {
+                beta = tt_score;
+            }
+            if (alpha >= beta) {
+                return tt_score;
+            }
+        }
     }
+    const int alpha_orig = alpha;
+    const int beta_orig = beta;
 
     ulong children_nodes[16][2];
     int children_nodes_len = get_children(black_board, white_board, turn, children_nodes);
     if (children_nodes_len == 0) {
-        return get_score(black_board, white_board, my_turn);
+        return line_eval_score(ev, my_turn);
     }
 
+    const ulong occupied = black_board | white_board;
+    const int side = side_index(turn);
     int scores[16];
     for (int i=0; i<children_nodes_len; i++) {
-        scores[i] = get_score(children_nodes[i][0], children_nodes[i][1], my_turn);
+        const int cell = binary2decimal((children_nodes[i][0] | children_nodes[i][1]) ^ occupied);
+        line_eval_make(ev, side, cell);
+        scores[i] = line_eval_score(ev, my_turn);
+        line_eval_unmake(ev, side, cell);
     }
 
     // sort
@@ -438,497 +634,2953 @@ int alphabeta(const ulong black_board, const ulong white_board, int depth, int a
         }
     }
 
-    if (turn == my_turn) {
-        int value = -10000;
-        for (int i = 0; i < children_nodes_len; i++) {
-            int score = alphabeta(children_nodes[i][0], children_nodes[i][1], depth-1, alpha,
-                                    beta, convert_turn(turn), my_turn);
+    // The table's best move goes first; the rest keep their static order.
+    if (tt_move >= 0) {
+        const ulong tt_bit = decimal2binary(tt_move);
+        for (int i=0; i<children_nodes_len; i++) {
+            if (((children_nodes[i][0] | children_nodes[i][1]) ^ occupied) == tt_bit) {
+                ulong temp_black = children_nodes[i][0];
+                ulong temp_white = children_nodes[i][1];
+                for (int j=i; j>0; j--) {
+                    children_nodes[j][0] = children_nodes[j-1][0];
+                    children_nodes[j][1] = children_nodes[j-1][1];
+                }
+                children_nodes[0][0] = temp_black;
+                children_nodes[0][1] = temp_white;
+                break;
+            }
+        }
+    }
+
+    const bool maximizing = (turn == my_turn);
+    const bool split = (depth >= YBW_MIN_DEPTH && children_nodes_len > 1 && omp_get_num_threads() > 1);
+    const int serial_len = split ? 1 : children_nodes_len;
+    int value = maximizing ? -10000 : 10000;
+    int best_i = 0;
+    for (int i=0; i<serial_len; i++) {
+        const int cell = binary2decimal((children_nodes[i][0] | children_nodes[i][1]) ^ occupied);
+        line_eval_make(ev, side, cell);
+        int score = alphabeta(children_nodes[i][0], children_nodes[i][1], ev, depth-1, alpha, beta,
+                                convert_turn(turn), my_turn, sp);
+        line_eval_unmake(ev, side, cell);
+        if (maximizing) {
             if (score > value) {
                 value = score;
+                best_i = i;
             }
             if (value > alpha) {
                 alpha = value;
             }
-            if (alpha >= beta) {
-                break;
-            }
-        }
-        return value;
-    } else {
-        int value = 10000;
-        for (int i=0; i<children_nodes_len; i++) {
-            int score = alphabeta(children_nodes[i][0], children_nodes[i][1], depth-1, alpha, beta,
-                                    convert_turn(turn), my_turn);
+        } else {
             if (score < value) {
                 value = score;
+                best_i = i;
             }
             if (value < beta) {
                 beta = value;
             }
-            if (alpha >= beta) {
-                break;
+        }
+        if (alpha >= beta) {
+            break;
+        }
+    }
+
+    if (split && alpha < beta && !search_stopped() && !split_aborted(sp)) {
+        SplitPoint node = { .parent = sp, .cutoff = 0 };
+        for (int i=1; i<children_nodes_len; i++) {
+            #pragma omp task firstprivate(i) shared(node, children_nodes, value, best_i, alpha, beta)
+            {
+                int a, b;
+                #pragma omp atomic read
+                a = alpha;
+                #pragma omp atomic read
+                b = beta;
+                if (a < b && !split_aborted(&node)) {
+                    // Each task works on its own copy; ev is left untouched until taskwait.
+                    LineEval child_ev = *ev;
+                    line_eval_make(&child_ev, side,
+                                   binary2decimal((children_nodes[i][0] | children_nodes[i][1]) ^ occupied));
+                    int score = alphabeta(children_nodes[i][0], children_nodes[i][1], &child_ev, depth-1, a, b,
+                                            convert_turn(turn), my_turn, &node);
+                    if (!search_stopped() && !split_aborted(&node)) {
+                        #pragma omp critical(ybw_split)
+                        {
+                            if (maximizing) {
+                                if (score > value) {
+                                    value = score;
+                                    best_i = i;
+                                }
+                                if (value > alpha) {
+                                    #pragma omp atomic write
+                                    alpha = value;
+                                }
+                            } else {
+                                if (score < value) {
+                                    value = score;
+                                    best_i = i;
+                                }
+                                if (value < beta) {
+                                    #pragma omp atomic write
+                                    beta = value;
+                                }
+                            }
+                            if (alpha >= beta) {
+                                __atomic_store_n(&node.cutoff, 1, __ATOMIC_RELAXED);
+                            }
+                        }
+                    }
+                }
             }
         }
+        #pragma omp taskwait
+    }
+
+    if (search_stopped() || split_aborted(sp)) {
         return value;
     }
+    int bound = TT_BOUND_EXACT;
+    if (value <= alpha_orig) {
+        bound = TT_BOUND_UPPER;
+    } else if (value >= beta_orig) {
+        bound = TT_BOUND_LOWER;
+    }
+    const int best_move = binary2decimal((children_nodes[best_i][0] | children_nodes[best_i][1]) ^ occupied);
+    tt_store(key, t_search->generation, depth, flip ? tt_flip_bound(bound) : bound, flip ? -value : value, best_move);
+    return value;
 }
 
-ulong minmax_act(const ulong black_board, const ulong white_board, char my_turn, int depth) {
-    ulong next_boards[16][2];
+// Searches the root children to `depth` with the same eldest-first split as alphabeta().
+// The child playing pv_move (if any) goes first; scores[i] is exact where exact[i] is set
+// and an upper bound otherwise. Returns the index of the best child, or -1 if there is none.
+static int minmax_root(SearchCtx *ctx, const ulong black_board, const ulong white_board, char my_turn, int depth,
+                       int pv_move, int threads, ulong next_boards[16][2], int scores[16], bool exact[16],
+                       int *out_len) {
     int next_boards_len = get_children(black_board, white_board, my_turn, next_boards);
+    *out_len = next_boards_len;
+    if (next_boards_len <= 0) return -1;
+
+    const ulong occupied = black_board | white_board;
+    if (pv_move >= 0) {
+        const ulong pv_bit = decimal2binary(pv_move);
+        for (int i=1; i<next_boards_len; i++) {
+            if (((next_boards[i][0] | next_boards[i][1]) ^ occupied) == pv_bit) {
+                ulong temp_black = next_boards[i][0];
+                ulong temp_white = next_boards[i][1];
+                next_boards[i][0] = next_boards[0][0];
+                next_boards[i][1] = next_boards[0][1];
+                next_boards[0][0] = temp_black;
+                next_boards[0][1] = temp_white;
+                break;
+            }
+        }
+    }
+
+    LineEval root_ev;
+    line_eval_init(&root_ev, black_board, white_board);
+    const int side = side_index(my_turn);
+
+    int alpha = -10000;
+    int best_i = 0;
+    #pragma omp parallel num_threads(threads)
+    {
+        t_search = ctx;
+        #pragma omp single
+        {
+            LineEval first_ev = root_ev;
+            line_eval_make(&first_ev, side, binary2decimal((next_boards[0][0] | next_boards[0][1]) ^ occupied));
+            scores[0] = alphabeta(next_boards[0][0], next_boards[0][1], &first_ev, depth, -10000, 10000,
+                                  convert_turn(my_turn), my_turn, NULL);
+            exact[0] = true;
+            alpha = scores[0];
+            for (int i=1; i<next_boards_len; i++) {
+                #pragma omp task firstprivate(i) shared(alpha, best_i, next_boards, scores, exact, root_ev)
+                {
+                    int a;
+                    #pragma omp atomic read
+                    a = alpha;
+                    LineEval child_ev = root_ev;
+                    line_eval_make(&child_ev, side, binary2decimal((next_boards[i][0] | next_boards[i][1]) ^ occupied));
+                    const int score = alphabeta(next_boards[i][0], next_boards[i][1], &child_ev, depth, a, 10000,
+                                                convert_turn(my_turn), my_turn, NULL);
+                    scores[i] = score;
+                    exact[i] = (score > a);
+                    #pragma omp critical(ybw_root)
+                    {
+                        // Ties go to the earlier (better-ordered) child.
+                        if (exact[i] && (score > alpha || (score == alpha && i < best_i))) {
+                            best_i = i;
+                            #pragma omp atomic write
+                            alpha = score;
+                        }
+                    }
+                }
+            }
+            #pragma omp taskwait
+        }
+        tt_flush_stats(&ctx->tt);
+        search_flush_nodes();
+    }
+    return best_i;
+}
+
+static void minmax_print_nodes(int depth, long long nodes, double elapsed_s, int threads) {
+    printf("minmax depth=%d nodes=%lld time=%.1fms nps=%.0f threads=%d\n",
+           depth, nodes, elapsed_s * 1000.0, (elapsed_s > 0.0) ? ((double)nodes / elapsed_s) : 0.0, threads);
+}
+
+// time_ms <= 0 and no stop flag: one search to cfg->depth.
+// Otherwise: iterative deepening up to cfg->depth (<=0: to the end of the game),
+// returning the deepest iteration that finished inside the budget / before *stop.
+ulong minmax_act(const ulong black_board, const ulong white_board, char my_turn, const MinimaxConfig *cfg) {
+    const int threads = (cfg->threads > 0) ? cfg->threads : omp_get_max_threads();
+    SearchCtx ctx = { .generation = tt_new_search() };
+    const double start = omp_get_wtime();
+    const TTPos root_key = tt_pos(black_board, white_board);
+    const ulong occupied = black_board | white_board;
+    TTHit hit;
+    int pv_move = -1;
+    if (tt_probe(root_key, &hit)) {
+        pv_move = hit.move;
+    }
 
+    ulong next_boards[16][2];
     int scores[16];
-    #pragma omp parallel for
-    for (int i=0; i<next_boards_len; i++) {
-        int score = alphabeta(next_boards[i][0], next_boards[i][1], depth, -10000, 10000, convert_turn(my_turn), my_turn);
-        printf("%16lx: %d\n", next_boards[i][0] | next_boards[i][1], score);
-        scores[i] = score;
+    bool exact[16];
+    int n = 0;
+    ulong best = 0;
+    int best_score = 0;
+    int best_depth = -1;
+    if (cfg->time_ms <= 0 && !cfg->stop) {
+        const int best_i = minmax_root(&ctx, black_board, white_board, my_turn, cfg->depth, pv_move, threads,
+                                       next_boards, scores, exact, &n);
+        for (int i=0; i<n && cfg->verbose >= 1; i++) {
+            printf("%16lx: %s%d\n", next_boards[i][0] | next_boards[i][1], exact[i] ? "" : "<=", scores[i]);
+        }
+        if (best_i >= 0) {
+            best = occupied ^ (next_boards[best_i][0] | next_boards[best_i][1]);
+            best_score = scores[best_i];
+            best_depth = cfg->depth;
+        }
+        if (cfg->verbose >= 1) {
+            minmax_print_nodes(cfg->depth, ctx.nodes, omp_get_wtime() - start, threads);
+        }
+    } else {
+        const int empties = 64 - __builtin_popcountl(occupied);
+        const int max_depth = (cfg->depth > 0 && cfg->depth < empties) ? cfg->depth : empties - 1;
+        for (int d = 0; d <= max_depth; d++) {
+            // The first iteration always completes so there is a move to return.
+            ctx.deadline = (d == 0 || cfg->time_ms <= 0) ? 0.0 : start + (double)cfg->time_ms / 1000.0;
+            ctx.abort = (d == 0) ? NULL : cfg->stop;
+            ctx.stop = 0;
+            const int best_i = minmax_root(&ctx, black_board, white_board, my_turn, d, pv_move, threads,
+                                           next_boards, scores, exact, &n);
+            if (best_i < 0 || ctx.stop) break;
+
+            best = occupied ^ (next_boards[best_i][0] | next_boards[best_i][1]);
+            best_score = scores[best_i];
+            best_depth = d;
+            pv_move = binary2decimal(best);
+            if (cfg->verbose >= 1) {
+                printf("minmax depth=%d score=%d move=%d time=%.1fms\n",
+                       d, best_score, pv_move, (omp_get_wtime() - start) * 1000.0);
+            }
+            if (cfg->on_iteration) {
+                cfg->on_iteration(cfg->on_iteration_arg, d, best_score, pv_move, ctx.nodes, omp_get_wtime() - start);
+            }
+            // A proven win or loss will not change with more depth.
+            if (best_score >= 100 || best_score <= -100) break;
+            if (cfg->time_ms > 0 && omp_get_wtime() - start >= (double)cfg->time_ms / 1000.0) break;
+        }
+        if (cfg->verbose >= 1) {
+            minmax_print_nodes(best_depth, ctx.nodes, omp_get_wtime() - start, threads);
+        }
+    }
+    if (cfg->nodes) *cfg->nodes = ctx.nodes;
+
+    if (best_depth >= 0) {
+        tt_store(root_key, ctx.generation, best_depth + 1, TT_BOUND_EXACT, best_score, binary2decimal(best));
+    }
+    if (g_tt.entries && cfg->verbose >= 1) {
+        const long long probes = ctx.tt.hits + ctx.tt.misses;
+        printf("tt: hits=%lld misses=%lld collisions=%lld hit_rate=%.1f%% size=%zuMB\n",
+               ctx.tt.hits, ctx.tt.misses, ctx.tt.collisions,
+               (probes > 0) ? (100.0 * (double)ctx.tt.hits / (double)probes) : 0.0,
+               g_tt.bytes >> 20);
     }
+    return best;
+}
 
-    return (black_board | white_board) ^ (next_boards[max_index(scores, next_boards_len)][0]
-                | next_boards[max_index(scores, next_boards_len)][1]);
+// Follows the table's best moves from (black, white) until a miss, an illegal move or
+// the end of the game. Returns the number of moves written to pv[].
+static int tt_pv(ulong black, ulong white, char turn, int pv[], int max_len) {
+    int n = 0;
+    while (n < max_len) {
+        TTHit hit;
+        if (!tt_probe(tt_pos(black, white), &hit) || hit.move < 0) break;
+        const ulong mv = decimal2binary(hit.move);
+        if ((mv & get_possible_pos_board(black, white)) == 0) break;
+        pv[n++] = hit.move;
+        if (turn == 'b') black |= mv; else white |= mv;
+        if (which_is_win(black, white) != 'n') break;
+        turn = convert_turn(turn);
+    }
+    return n;
 }
 
 // ----------------------------
-// MCTS (root-parallel UCT)
+// MCTS (root- or tree-parallel UCT)
 // ----------------------------
+typedef enum {
+    MCTS_PARALLEL_ROOT = 0,    // one private tree per thread, root stats summed at the end
+    MCTS_PARALLEL_TREE = 1,    // one tree shared by all threads (virtual loss, lock-free expansion)
+} MctsParallel;
+
 typedef struct {
     long long iterations;      // <=0: no iteration limit (requires time_ms > 0)
     int time_ms;               // <=0: no time limit
     int threads;               // <=0: omp_get_max_threads()
     double c;                  // UCT exploration constant
     int rollout_max_depth;     // max rollout length
-    long long max_nodes;       // per-thread node cap (<=0: auto)
+    long long max_nodes;       // node cap per tree (root: per thread, tree: total; <=0: auto)
     int verbose;               // 0: quiet, >=1: per-move stats
     uint64_t seed;             // 0: auto
+    int parallel;              // MctsParallel
+    int reuse;                 // keep the subtree of the reached position between moves
+    int game_time_ms;          // >0: total thinking time per game, split over the moves
+    int solver;                // prove wins/losses in the tree (MCTS-Solver)
+    int rave;                  // blend AMAF statistics into selection (RAVE)
+    double rave_k;             // RAVE equivalence parameter: the AMAF weight is 1/2 at k visits
+    const int *stop;           // non-NULL: end the search early once *stop is set
 } MctsConfig;
 
+// 16-byte node, four per cache line. A node stores only the move that leads to it;
+// boards, side to move and terminal state are rebuilt while walking down from the
+// root. Children form a singly linked list (newest first) that a thread extends
+// with one CAS on `first_child`, so expansion needs no lock.
 typedef struct {
-    ulong black;
-    ulong white;
-    int parent;
-    uint32_t visits;
+    uint32_t visits;           // completed + in-flight visits (virtual loss)
     float wins;                // sum of rewards for the player who just moved into this node
-    uint8_t child_count;
-    uint32_t children[16];
-    char turn;                 // player to move at this node ('b'/'w')
-    char result;               // 'n' ongoing, 'b','w','d'
+    uint32_t first_child;      // MCTS_SIBLING_MASK: newest child (0 = none), top bits: MctsProof
+    uint32_t sibling;          // MCTS_SIBLING_MASK: next older sibling (0 = none), top bits: move cell index
 } MctsNode;
 
+#define MCTS_MOVE_SHIFT 26
+#define MCTS_SIBLING_MASK ((UINT32_C(1) << MCTS_MOVE_SHIFT) - 1)
+#define MCTS_MAX_TREE_NODES ((long long)MCTS_SIBLING_MASK + 1)
+#define MCTS_MAX_PLY 64
+#define MCTS_PROOF_SHIFT 30
+
+// MCTS-Solver (Winands, Bjornsson & Saito, 2008): game-theoretic values, from the view
+// of the player who just moved into the node. A node with a child proven won for its
+// side to move is a proven loss; one whose legal moves are all expanded and proven lost
+// is a proven win. Selection never enters a proven loss, and a proven node ends the
+// descent with its exact value instead of a rollout.
+typedef enum {
+    MCTS_PROOF_NONE = 0,
+    MCTS_PROOF_WIN = 1,
+    MCTS_PROOF_LOSS = 2,
+} MctsProof;
+
+// All-moves-as-first statistics (RAVE), kept beside the node pool with the same index:
+// amaf[i] counts the simulations from the parent of node i in which its mover played
+// node i's move at any later point, not only as the next move.
+typedef struct {
+    uint32_t visits;
+    float wins;                // rewards for the mover, as in MctsNode.wins
+} MctsAmaf;
+
+typedef struct {
+    MctsNode *nodes;
+    MctsAmaf *amaf;            // NULL unless MctsConfig.rave; same capacity as nodes
+    uint32_t capacity;
+    uint32_t count;            // next free node (bumped atomically)
+    ulong black;               // root position
+    ulong white;
+    char turn;                 // player to move at the root
+    char result;               // 'n' ongoing, 'b','w','d'
+} MctsTree;
+
 static inline float reward_from_result(char result, char root_turn) {
     if (result == 'd') return 0.5f;
     if (result == root_turn) return 1.0f;
     return 0.0f;
 }
 
-static inline uint32_t mcts_select_child_uct(const MctsNode *nodes, uint32_t node_idx, double c) {
+static inline uint32_t mcts_next_sibling(const MctsNode *n) {
+    return n->sibling & MCTS_SIBLING_MASK;
+}
+
+static inline uint32_t mcts_first_child(const MctsNode *n) {
+    return __atomic_load_n(&n->first_child, __ATOMIC_ACQUIRE) & MCTS_SIBLING_MASK;
+}
+
+static inline int mcts_node_proof(const MctsNode *n) {
+    return (int)(__atomic_load_n(&n->first_child, __ATOMIC_RELAXED) >> MCTS_PROOF_SHIFT);
+}
+
+static inline void mcts_set_proof(MctsNode *n, int proof) {
+    __atomic_fetch_or(&n->first_child, (uint32_t)proof << MCTS_PROOF_SHIFT, __ATOMIC_RELAXED);
+}
+
+static inline ulong mcts_node_move(const MctsNode *n) {
+    return decimal2binary((int)(n->sibling >> MCTS_MOVE_SHIFT));
+}
+
+static inline float mcts_load_wins(const MctsNode *n) {
+    float w;
+    #pragma omp atomic read
+    w = n->wins;
+    return w;
+}
+
+// Plays `mv` for `turn` and returns the resulting state ('n', winner or 'd').
+static inline char mcts_play(ulong *black, ulong *white, char turn, ulong mv) {
+    ulong *own = (turn == 'b') ? black : white;
+    *own |= mv;
+    if (is_win_after_move(*own, mv)) return turn;
+    return (get_possible_pos_board(*black, *white) == 0) ? 'd' : 'n';
+}
+
+// UCT score of a visited child. With `amaf`, the exploitation term blends in the AMAF
+// winrate with weight beta = sqrt(k / (3n + k)) (Gelly & Silver, 2007), which starts at 1
+// and fades as the child's own visits n grow.
+static inline double mcts_uct_value(const MctsNode *child, const MctsAmaf *amaf, double rave_k,
+                                    double c, double log_parent, uint32_t visits) {
+    double q = (double)mcts_load_wins(child) / (double)visits;
+    if (amaf) {
+        const uint32_t av = __atomic_load_n(&amaf->visits, __ATOMIC_RELAXED);
+        if (av > 0) {
+            float aw;
+            #pragma omp atomic read
+            aw = amaf->wins;
+            const double beta = sqrt(rave_k / (3.0 * (double)visits + rave_k));
+            q = (1.0 - beta) * q + beta * (double)aw / (double)av;
+        }
+    }
+    return q + c * sqrt(log_parent / (double)visits);
+}
+
+// One pass over the children of `node_idx`: returns the UCT-best child (0 if none)
+// and the moves that already have a child in *expanded. A proven win always comes
+// first and proven losses are never chosen. `amaf` is NULL without RAVE.
+static inline uint32_t mcts_select_child_uct(const MctsNode *nodes, const MctsAmaf *amaf, double rave_k,
+                                             uint32_t node_idx, double c, ulong *expanded) {
     const MctsNode *node = &nodes[node_idx];
-    const double log_parent = log((double)node->visits + 1.0);
-    uint32_t best_child = node->children[0];
+    const double log_parent = log((double)__atomic_load_n(&node->visits, __ATOMIC_RELAXED) + 1.0);
+    uint32_t best_child = 0;
     double best = -1e300;
-    for (uint8_t i = 0; i < node->child_count; i++) {
-        const uint32_t ci = node->children[i];
+    ulong moves = 0;
+    for (uint32_t ci = mcts_first_child(node); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
         const MctsNode *child = &nodes[ci];
-        if (child->visits == 0) {
-            return ci;
+        moves |= mcts_node_move(child);
+        const int proof = mcts_node_proof(child);
+        if (proof == MCTS_PROOF_LOSS) continue;
+        const uint32_t visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED);
+        double uct;
+        if (proof == MCTS_PROOF_WIN) {
+            uct = HUGE_VAL;
+        } else if (visits == 0) {
+            uct = 1e300;
+        } else {
+            uct = mcts_uct_value(child, amaf ? &amaf[ci] : NULL, rave_k, c, log_parent, visits);
         }
-        const double mean = (double)child->wins / (double)child->visits;
-        const double uct = mean + c * sqrt(log_parent / (double)child->visits);
         if (uct > best) {
             best = uct;
             best_child = ci;
         }
     }
+    *expanded = moves;
     return best_child;
 }
 
-static inline bool mcts_move_is_expanded(const MctsNode *nodes, uint32_t parent_idx, const ulong move_bit) {
-    const MctsNode *parent = &nodes[parent_idx];
-    const ulong parent_occ = parent->black | parent->white;
-    for (uint8_t i = 0; i < parent->child_count; i++) {
-        const MctsNode *child = &nodes[parent->children[i]];
-        const ulong child_occ = child->black | child->white;
-        if ((child_occ ^ parent_occ) == move_bit) {
-            return true;
+static inline uint32_t mcts_tree_used(const MctsTree *tree) {
+    const uint32_t n = __atomic_load_n(&tree->count, __ATOMIC_RELAXED);
+    return (n < tree->capacity) ? n : tree->capacity;
+}
+
+// Finds the node holding (black, white) among the root and the two plies below it.
+// On success the node's state is returned in *result.
+static int mcts_find_descendant(const MctsTree *tree, ulong black, ulong white, char *result) {
+    const MctsNode *nodes = tree->nodes;
+    if (tree->black == black && tree->white == white) {
+        *result = tree->result;
+        return 0;
+    }
+    for (uint32_t ci = mcts_first_child(&nodes[0]); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+        ulong cb = tree->black, cw = tree->white;
+        const char cr = mcts_play(&cb, &cw, tree->turn, mcts_node_move(&nodes[ci]));
+        if (cb == black && cw == white) {
+            *result = cr;
+            return (int)ci;
+        }
+        if (cr != 'n' || ((cb | cw) & ~(black | white)) != 0) continue;
+        for (uint32_t gi = mcts_first_child(&nodes[ci]); gi != 0; gi = mcts_next_sibling(&nodes[gi])) {
+            ulong gb = cb, gw = cw;
+            const char gr = mcts_play(&gb, &gw, convert_turn(tree->turn), mcts_node_move(&nodes[gi]));
+            if (gb == black && gw == white) {
+                *result = gr;
+                return (int)gi;
+            }
         }
     }
-    return false;
+    return -1;
 }
 
-static inline ulong mcts_rollout_pick_move(ulong black, ulong white, char turn, Rng *rng) {
-    ulong moves[16];
-    const int n = get_possible_poses_binary(black, white, moves);
-    if (n <= 0) return 0;
-
-    // 1) winning move
-    for (int i = 0; i < n; i++) {
-        const ulong mv = moves[i];
-        if (turn == 'b') {
-            const ulong b2 = black | mv;
-            if (is_win_after_move(b2, mv)) return mv;
-        } else {
-            const ulong w2 = white | mv;
-            if (is_win_after_move(w2, mv)) return mv;
-        }
+// Makes `new_root` the root and keeps only its subtree, compacted to the front of the pool.
+// The kept nodes are copied out in breadth-first order and back, so their indices need not
+// follow the tree: a thread that lost an expansion CAS may link its spare node under a
+// parent allocated later.
+static void mcts_tree_reroot(MctsTree *tree, uint32_t new_root) {
+    MctsNode *nodes = tree->nodes;
+    const uint32_t count = mcts_tree_used(tree);
+    uint32_t *remap = (uint32_t*)malloc((size_t)count * sizeof(uint32_t));
+    uint32_t *order = (uint32_t*)malloc((size_t)count * sizeof(uint32_t));
+    if (!remap || !order) {
+        free(remap);
+        free(order);
+        tree->count = 0;
+        return;
     }
 
-    // 2) block opponent's immediate win
-    const char opp = convert_turn(turn);
-    for (int i = 0; i < n; i++) {
-        const ulong mv = moves[i];
-        if (opp == 'b') {
-            const ulong b2 = black | mv;
-            if (is_win_after_move(b2, mv)) return mv;
-        } else {
-            const ulong w2 = white | mv;
-            if (is_win_after_move(w2, mv)) return mv;
+    uint32_t kept = 0;
+    order[kept++] = new_root;
+    for (uint32_t k = 0; k < kept; k++) {
+        const uint32_t i = order[k];
+        remap[i] = k;
+        for (uint32_t ci = mcts_first_child(&nodes[i]); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+            order[kept++] = ci;
         }
     }
 
-    // 3) random
-    return moves[(int)rng_uniform_u32(rng, (uint32_t)n)];
-}
+    MctsNode *copy = (MctsNode*)malloc((size_t)kept * sizeof(MctsNode));
+    MctsAmaf *amaf_copy = tree->amaf ? (MctsAmaf*)malloc((size_t)kept * sizeof(MctsAmaf)) : NULL;
+    if (!copy || (tree->amaf && !amaf_copy)) {
+        free(copy);
+        free(amaf_copy);
+        free(remap);
+        free(order);
+        tree->count = 0;
+        return;
+    }
+    for (uint32_t k = 0; k < kept; k++) {
+        MctsNode n = nodes[order[k]];
+        const uint32_t first = mcts_first_child(&n);
+        if (first != 0) n.first_child = (n.first_child & ~MCTS_SIBLING_MASK) | remap[first];
+        const uint32_t next = mcts_next_sibling(&n);
+        if (next != 0) n.sibling = (n.sibling & ~MCTS_SIBLING_MASK) | remap[next];
+        copy[k] = n;
+        if (amaf_copy) amaf_copy[k] = tree->amaf[order[k]];
+    }
+    copy[0].sibling = 0;
+    memcpy(nodes, copy, (size_t)kept * sizeof(MctsNode));
+    if (amaf_copy) memcpy(tree->amaf, amaf_copy, (size_t)kept * sizeof(MctsAmaf));
+    free(copy);
+    free(amaf_copy);
+    free(remap);
+    free(order);
+    tree->count = kept;
+}
+
+// Moves the root of `tree` to (black, white), one or two plies below it, keeping only
+// that subtree. Returns false when the position is not in the tree.
+static bool mcts_tree_advance(MctsTree *tree, ulong black, ulong white, char turn) {
+    char result = 'n';
+    const int r = mcts_find_descendant(tree, black, white, &result);
+    if (r < 0) return false;
+    mcts_tree_reroot(tree, (uint32_t)r);
+    tree->black = black;
+    tree->white = white;
+    tree->turn = turn;
+    tree->result = result;
+    return true;
+}
+
+// Readies `tree` for a search from (black, white). With `reuse`, the subtree already built
+// for this position is kept. The pool is grown to `capacity` nodes, plus the kept ones
+// when `grow` is set; with `rave` the AMAF array follows it. Returns the number of nodes
+// kept, or -1 when out of memory.
+static long long mcts_tree_prepare(MctsTree *tree, long long capacity, bool grow, long long max_capacity,
+                                   ulong black, ulong white, char turn, bool reuse, bool rave) {
+    uint32_t kept = 0;
+    if (reuse && tree->nodes && mcts_tree_used(tree) > 0 && mcts_tree_advance(tree, black, white, turn)) {
+        kept = tree->count;
+    }
+
+    long long want = grow ? capacity + kept : capacity;
+    if (want > max_capacity) want = max_capacity;
+    if (want < (long long)kept) want = kept;
+    const bool resize = !tree->nodes || want > (long long)tree->capacity;
+    if (resize) {
+        MctsNode *nodes = (MctsNode*)realloc(tree->nodes, (size_t)want * sizeof(MctsNode));
+        if (!nodes) {
+            free(tree->nodes);
+            free(tree->amaf);
+            tree->nodes = NULL;
+            tree->amaf = NULL;
+            tree->capacity = 0;
+            tree->count = 0;
+            return -1;
+        }
+        tree->nodes = nodes;
+        tree->capacity = (uint32_t)want;
+    }
+    if (rave && (resize || !tree->amaf)) {
+        const bool fresh = !tree->amaf;
+        MctsAmaf *amaf = (MctsAmaf*)realloc(tree->amaf, (size_t)tree->capacity * sizeof(MctsAmaf));
+        if (!amaf) {
+            free(tree->nodes);
+            free(tree->amaf);
+            tree->nodes = NULL;
+            tree->amaf = NULL;
+            tree->capacity = 0;
+            tree->count = 0;
+            return -1;
+        }
+        if (fresh) memset(amaf, 0, (size_t)kept * sizeof(MctsAmaf));
+        tree->amaf = amaf;
+    }
+
+    if (kept == 0) {
+        memset(&tree->nodes[0], 0, sizeof(MctsNode));
+        if (tree->amaf) memset(&tree->amaf[0], 0, sizeof(MctsAmaf));
+        tree->count = 1;
+        tree->black = black;
+        tree->white = white;
+        tree->turn = turn;
+        tree->result = which_is_win(black, white);
+    }
+    return (long long)kept;
+}
+
+// Adds a child for one of the moves in `open` under `parent_idx`, reusing *spare if a
+// previous attempt lost its CAS. Returns the child, or 0 if the pool is full or another
+// thread added a child first (the caller then re-reads the child list).
+static uint32_t mcts_expand(MctsTree *tree, uint32_t parent_idx, ulong open, uint32_t *spare, Rng *rng) {
+    MctsNode *n = &tree->nodes[parent_idx];
+    const uint32_t head = __atomic_load_n(&n->first_child, __ATOMIC_ACQUIRE);
+
+    uint32_t child = *spare;
+    if (child == 0) {
+        child = __atomic_fetch_add(&tree->count, 1, __ATOMIC_RELAXED);
+        if (child >= tree->capacity) return 0;
+    }
+
+    const ulong chosen = nth_move(open, rng_uniform_u32(rng, (uint32_t)count_moves(open)));
+    MctsNode *c = &tree->nodes[child];
+    c->visits = 1; // virtual loss for the simulation that is about to run through it
+    c->wins = 0.0f;
+    c->first_child = 0;
+    c->sibling = ((uint32_t)binary2decimal(chosen) << MCTS_MOVE_SHIFT) | (head & MCTS_SIBLING_MASK);
+    if (tree->amaf) {
+        tree->amaf[child].visits = 0;
+        tree->amaf[child].wins = 0.0f;
+    }
+
+    // The parent's proof bits ride along; if one is set meanwhile the CAS fails and we retry.
+    uint32_t expected = head;
+    if (!__atomic_compare_exchange_n(&n->first_child, &expected, child | (head & ~MCTS_SIBLING_MASK), false,
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        *spare = child;
+        return 0;
+    }
+    *spare = 0;
+    return child;
+}
+
+static inline ulong mcts_rollout_pick_move(ulong black, ulong white, char turn, Rng *rng) {
+    const ulong moves = get_possible_pos_board(black, white);
+    if (moves == 0) return 0;
+
+    const ulong own = (turn == 'b') ? black : white;
+    const ulong opp = (turn == 'b') ? white : black;
+    const ulong opp_threats = threat_cells(opp, own);
+
+    // 1) winning move
+    const ulong wins = threat_cells(own, opp) & moves;
+    if (wins != 0) return first_move(wins);
 
-static inline float mcts_rollout_value(ulong black, ulong white, char turn, char root_turn, int max_depth, Rng *rng) {
-    char res = which_is_win(black, white);
+    // 2) block opponent's immediate win
+    const ulong blocks = opp_threats & moves;
+    if (blocks != 0) return first_move(blocks);
+
+    // 3) random, avoiding moves that open the cell above to an opponent's win
+    const ulong safe = moves & ~(opp_threats << 16);
+    const ulong pool = (safe != 0) ? safe : moves;
+    return nth_move(pool, rng_uniform_u32(rng, (uint32_t)count_moves(pool)));
+}
+
+// Plays a rollout from (black, white) and returns its value for `root_turn`. The boards
+// at the end of the rollout are left in *black and *white (for the AMAF update).
+static inline float mcts_rollout_value(ulong *black, ulong *white, char turn, char root_turn, int max_depth, Rng *rng) {
+    char res = which_is_win(*black, *white);
     if (res != 'n') {
         return reward_from_result(res, root_turn);
     }
 
     for (int d = 0; d < max_depth; d++) {
-        const ulong mv = mcts_rollout_pick_move(black, white, turn, rng);
+        const ulong mv = mcts_rollout_pick_move(*black, *white, turn, rng);
         if (mv == 0) {
             return 0.5f;
         }
 
         if (turn == 'b') {
-            black |= mv;
-            if (is_win_after_move(black, mv)) {
+            *black |= mv;
+            if (is_win_after_move(*black, mv)) {
                 return reward_from_result('b', root_turn);
             }
         } else {
-            white |= mv;
-            if (is_win_after_move(white, mv)) {
+            *white |= mv;
+            if (is_win_after_move(*white, mv)) {
                 return reward_from_result('w', root_turn);
             }
         }
-        if (get_possible_pos_board(black, white) == 0) {
+        if (get_possible_pos_board(*black, *white) == 0) {
             return 0.5f;
         }
         turn = convert_turn(turn);
     }
 
     // Depth cutoff: cheap heuristic as a small bias around 0.5.
-    const int score = get_score(black, white, root_turn);
+    const int score = get_score(*black, *white, root_turn);
     const double v = 0.5 + 0.25 * tanh((double)score / 20.0);
     if (v <= 0.0) return 0.0f;
     if (v >= 1.0) return 1.0f;
     return (float)v;
 }
 
-static ulong mcts_act(const ulong black_board, const ulong white_board, char my_turn, const MctsConfig *cfg) {
+// Time management. One thread looks at the root every MCTS_TM_INTERVAL seconds. With a
+// time budget or game clock, the search ends early once the visit leader cannot be
+// overtaken by the simulations left before the planned stop; a pure iteration budget
+// always runs to the end, so its result does not depend on timing. With a game clock, the planned stop (soft_end) comes before
+// the hard one. At soft_end the search goes on while the position is unstable: the
+// leader changed since the last look, or the runner-up has the better winrate.
+#define MCTS_TM_INTERVAL 0.005
+#define MCTS_CLOCK_MIN_MOVES 8     // never plan for fewer own moves than this
+#define MCTS_CLOCK_STRETCH 3.0     // unstable positions may use this many planned budgets
+
+typedef enum {
+    MCTS_STOP_LIMIT = 0,       // time, iterations or an external stop
+    MCTS_STOP_LEAD,            // the leader could no longer be overtaken
+    MCTS_STOP_PLAN,            // planned time used and the position is stable
+    MCTS_STOP_FORCED,          // no search: a win, a must-block or the only legal move
+    MCTS_STOP_PROVEN,          // the solver proved a root move won, or every root move lost
+} MctsStop;
+
+static const char *const k_mcts_stop_names[] = {"limit", "lead", "plan", "forced", "proven"};
+
+// Shared by the threads of one mcts_act() call.
+typedef struct {
+    int halt;                  // set when the search should end
+    int reason;                // MctsStop
+    double start;
+    double soft_end;           // planned stop (1e300: none)
+    double hard_end;           // latest stop (1e300: none)
+    double next_check;
+    long long iter_target;
+    const long long *sims_done;
+    const MctsTree *trees;
+    int tree_count;
+    const ulong *root_moves;
+    int root_moves_len;
+    int last_best;             // visit leader at the previous look (-1: none)
+} MctsTimeCtl;
+
+static void mcts_tm_check(MctsTimeCtl *tm, double now) {
+    long long visits[16] = {0};
+    double wins[16] = {0.0};
+    for (int t = 0; t < tm->tree_count; t++) {
+        const MctsNode *nodes = tm->trees[t].nodes;
+        if (!nodes) continue;
+        for (uint32_t ci = mcts_first_child(&nodes[0]); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+            const ulong mv = mcts_node_move(&nodes[ci]);
+            for (int j = 0; j < tm->root_moves_len; j++) {
+                if (tm->root_moves[j] != mv) continue;
+                visits[j] += __atomic_load_n(&nodes[ci].visits, __ATOMIC_RELAXED);
+                wins[j] += mcts_load_wins(&nodes[ci]);
+                break;
+            }
+        }
+    }
+    int best = -1, second = -1;
+    for (int j = 0; j < tm->root_moves_len; j++) {
+        if (best < 0 || visits[j] > visits[best]) {
+            second = best;
+            best = j;
+        } else if (second < 0 || visits[j] > visits[second]) {
+            second = j;
+        }
+    }
+    if (best < 0 || visits[best] == 0) return;
+
+    const long long done = __atomic_load_n(tm->sims_done, __ATOMIC_RELAXED);
+    long long left = (tm->iter_target != LLONG_MAX) ? tm->iter_target - done : LLONG_MAX;
+    const double end = (now < tm->soft_end) ? tm->soft_end : tm->hard_end;
+    if (end < 1e300 && now > tm->start) {
+        const double by_time = (double)done / (now - tm->start) * (end - now);
+        if (by_time < (double)left) left = (by_time > 0.0) ? (long long)by_time : 0;
+    }
+    const long long runner_up = (second >= 0) ? visits[second] : 0;
+    if (end < 1e300 && visits[best] - runner_up > left) {
+        tm->reason = MCTS_STOP_LEAD;
+        __atomic_store_n(&tm->halt, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (now >= tm->soft_end) {
+        const bool changed = (best != tm->last_best);
+        const bool contested = runner_up > 0
+            && wins[second] / (double)runner_up > wins[best] / (double)visits[best];
+        if (!changed && !contested) {
+            tm->reason = MCTS_STOP_PLAN;
+            __atomic_store_n(&tm->halt, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    tm->last_best = best;
+}
+
+// Carries a proof at the end of `path` up the tree while it decides the parents: a child
+// proven won for its mover makes the parent a loss, and a parent whose `legal` moves are
+// all expanded and proven lost is a win. Returns true once the root is decided, i.e. a
+// root move is a proven win or all of them are proven losses.
+static bool mcts_solver_backup(MctsNode *nodes, const uint32_t *path, const uint8_t *legal, int depth) {
+    for (int d = depth; d > 0; d--) {
+        const int proof = mcts_node_proof(&nodes[path[d]]);
+        MctsNode *parent = &nodes[path[d - 1]];
+        if (proof == MCTS_PROOF_WIN) {
+            if (d == 1) return true;
+            mcts_set_proof(parent, MCTS_PROOF_LOSS);
+        } else if (proof == MCTS_PROOF_LOSS) {
+            int lost = 0;
+            for (uint32_t ci = mcts_first_child(parent); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+                if (mcts_node_proof(&nodes[ci]) != MCTS_PROOF_LOSS) return false;
+                lost++;
+            }
+            if (lost < legal[d - 1]) return false;
+            if (d == 1) return true;
+            mcts_set_proof(parent, MCTS_PROOF_WIN);
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+// AMAF backup: for every node on the path that was expanded past (the descent records
+// path_own for it), each child whose move its mover played later in the simulation, in
+// the tree or in the rollout, is credited as if it had been played first. (black, white)
+// is the final position. Every cell is played at most once, so "played later by the
+// mover" is the mover's final pieces minus those it had at that node.
+static void mcts_amaf_update(const MctsNode *nodes, MctsAmaf *amaf, const uint32_t *path, const ulong *path_own,
+                             int depth, char root_turn, ulong black, ulong white, float value) {
+    for (int d = 0; d < depth; d++) {
+        const bool root_moves = (d & 1) == 0;
+        const ulong final_own = ((root_moves ? root_turn : convert_turn(root_turn)) == 'b') ? black : white;
+        const ulong played = final_own & ~path_own[d];
+        const float add = root_moves ? value : (1.0f - value);
+        for (uint32_t ci = mcts_first_child(&nodes[path[d]]); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+            if ((mcts_node_move(&nodes[ci]) & played) == 0) continue;
+            __atomic_fetch_add(&amaf[ci].visits, 1, __ATOMIC_RELAXED);
+            #pragma omp atomic
+            amaf[ci].wins += add;
+        }
+    }
+}
+
+// Runs simulations on `tree` until the time or the shared iteration budget runs out.
+// Safe to call from several threads on the same tree: visits taken on the way down
+// act as a virtual loss until the result is backed up. The `manager` thread also runs
+// the time manager.
+static void mcts_search(MctsTree *tree, const MctsConfig *cfg, double end_time,
+                        long long iter_target, long long *sims_done, Rng *rng,
+                        MctsTimeCtl *tm, bool manager) {
+    MctsNode *nodes = tree->nodes;
+    const char root_turn = tree->turn;
+    MctsAmaf *amaf = cfg->rave ? tree->amaf : NULL;
+    uint32_t path[MCTS_MAX_PLY + 1];
+    uint8_t legal[MCTS_MAX_PLY + 1];   // legal move count at path[d]
+    ulong path_own[MCTS_MAX_PLY + 1];  // pieces of the side to move at path[d] (RAVE)
+    uint32_t spare = 0;
+    long long pending = 0;
+    while (1) {
+        if ((pending & 0x3f) == 0) {
+            if (end_time < 1e300 && omp_get_wtime() >= end_time) break;
+            if (cfg->stop && __atomic_load_n(cfg->stop, __ATOMIC_RELAXED) != 0) break;
+            if (__atomic_load_n(&tm->halt, __ATOMIC_RELAXED) != 0) break;
+            if (manager) {
+                const double now = omp_get_wtime();
+                if (now >= tm->next_check) {
+                    tm->next_check = now + MCTS_TM_INTERVAL;
+                    mcts_tm_check(tm, now);
+                }
+            }
+            if (cfg->iterations > 0) {
+                long long cur;
+                #pragma omp atomic read
+                cur = *sims_done;
+                if (cur >= iter_target) break;
+            }
+        }
+
+        // Selection + expansion (at most 1 new node)
+        ulong black = tree->black;
+        ulong white = tree->white;
+        char turn = root_turn;
+        char result = tree->result;
+        int depth = 0;
+        int proof = MCTS_PROOF_NONE;
+        path[0] = 0;
+        while (result == 'n') {
+            ulong expanded;
+            const uint32_t cur = path[depth];
+            if (depth > 0 && cfg->solver && (proof = mcts_node_proof(&nodes[cur])) != MCTS_PROOF_NONE) break;
+            const uint32_t best = mcts_select_child_uct(nodes, amaf, cfg->rave_k, cur, cfg->c, &expanded);
+            const ulong moves = get_possible_pos_board(black, white);
+            const ulong open = moves & ~expanded;
+            legal[depth] = (uint8_t)count_moves(moves);
+            path_own[depth] = (turn == 'b') ? black : white;
+            uint32_t next = 0;
+            if (open != 0 && __atomic_load_n(&tree->count, __ATOMIC_RELAXED) < tree->capacity) {
+                next = mcts_expand(tree, cur, open, &spare, rng);
+                if (next == 0 && spare != 0) continue; // lost the race: re-read the children
+            }
+            const bool new_leaf = (next != 0);
+            if (next == 0) {
+                if (best == 0) break;
+                next = best;
+                __atomic_fetch_add(&nodes[next].visits, 1, __ATOMIC_RELAXED);
+            }
+            result = mcts_play(&black, &white, turn, mcts_node_move(&nodes[next]));
+            if (new_leaf && result == turn && cfg->solver) mcts_set_proof(&nodes[next], MCTS_PROOF_WIN);
+            turn = convert_turn(turn);
+            path[++depth] = next;
+            if (new_leaf) break;
+        }
+
+        // Simulation. A proven node is worth its exact value; the player who moved into
+        // path[d] is the root player exactly when d is odd.
+        float value;
+        if (proof != MCTS_PROOF_NONE) {
+            value = ((proof == MCTS_PROOF_WIN) == ((depth & 1) != 0)) ? 1.0f : 0.0f;
+        } else if (result != 'n') {
+            value = reward_from_result(result, root_turn);
+        } else {
+            value = mcts_rollout_value(&black, &white, turn, root_turn, cfg->rollout_max_depth, rng);
+        }
+        if (amaf) mcts_amaf_update(nodes, amaf, path, path_own, depth, root_turn, black, white, value);
+
+        // Backprop: non-root visits were already counted on the way down.
+        for (int d = depth; d > 0; d--) {
+            const float add = (d & 1) ? value : (1.0f - value);
+            #pragma omp atomic
+            nodes[path[d]].wins += add;
+        }
+        if (cfg->solver && mcts_solver_backup(nodes, path, legal, depth)) {
+            __atomic_store_n(&tm->reason, MCTS_STOP_PROVEN, __ATOMIC_RELAXED);
+            __atomic_store_n(&tm->halt, 1, __ATOMIC_RELAXED);
+        }
+        // Root has no "just moved" player; its wins is not used for selection anyway.
+        __atomic_fetch_add(&nodes[0].visits, 1, __ATOMIC_RELAXED);
+        #pragma omp atomic
+        nodes[0].wins += value;
+
+        pending++;
+        if ((pending & 0x3f) == 0) {
+            #pragma omp atomic
+            *sims_done += 64;
+            pending = 0;
+        }
+        if (end_time < 1e300 && omp_get_wtime() >= end_time) {
+            break;
+        }
+    }
+
+    if (pending > 0) {
+        #pragma omp atomic
+        *sims_done += pending;
+    }
+}
+
+// Adds the root children's stats of `tree` to the per-move totals and merges their proofs.
+static void mcts_accumulate_root(const MctsTree *tree, const ulong *root_moves, int root_moves_len,
+                                 long long *total_visits, double *total_wins, int *proofs) {
+    const MctsNode *nodes = tree->nodes;
+    for (uint32_t ci = mcts_first_child(&nodes[0]); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+        const ulong mv = mcts_node_move(&nodes[ci]);
+        for (int j = 0; j < root_moves_len; j++) {
+            if (root_moves[j] != mv) continue;
+            #pragma omp atomic
+            total_visits[j] += (long long)nodes[ci].visits;
+            #pragma omp atomic
+            total_wins[j] += (double)nodes[ci].wins;
+            #pragma omp atomic
+            proofs[j] |= mcts_node_proof(&nodes[ci]);
+            break;
+        }
+    }
+}
+
+// Persistent search state of one MCTS player: its trees survive between moves so the
+// next search can start from the subtree of the position actually reached.
+typedef struct {
+    MctsTree *trees;           // one per thread (root parallel) or a single shared tree
+    int tree_count;
+    long long sims;            // simulations run by the last search
+    double value;              // winrate of the move chosen by the last search
+    double clock_used_ms;      // game time spent so far (MctsConfig.game_time_ms)
+} MctsState;
+
+static void mcts_state_free(MctsState *state) {
+    for (int i = 0; i < state->tree_count; i++) {
+        free(state->trees[i].nodes);
+        free(state->trees[i].amaf);
+    }
+    free(state->trees);
+    state->trees = NULL;
+    state->tree_count = 0;
+}
+
+static ulong mcts_act(const ulong black_board, const ulong white_board, char my_turn, const MctsConfig *cfg, MctsState *state) {
     const int threads = (cfg->threads > 0) ? cfg->threads : omp_get_max_threads();
+    const bool shared = (cfg->parallel == MCTS_PARALLEL_TREE);
     const double start = omp_get_wtime();
-    const double end_time = (cfg->time_ms > 0) ? (start + (double)cfg->time_ms / 1000.0) : 1e300;
     const long long iter_target = (cfg->iterations > 0) ? cfg->iterations : LLONG_MAX;
 
     ulong root_moves[16];
     const int root_moves_len = get_possible_poses_binary(black_board, white_board, root_moves);
     if (root_moves_len <= 0) return 0;
 
+    // Under time management, forced moves need no search: take a win, else block the
+    // opponent's, else the only move. A fixed --mcts-iterations budget always searches,
+    // and so does ponder (no time budget), whose tree must cover the opponent's replies.
+    const bool timed = (cfg->time_ms > 0 || cfg->game_time_ms > 0);
+    const ulong legal = get_possible_pos_board(black_board, white_board);
+    const ulong own = (my_turn == 'b') ? black_board : white_board;
+    const ulong opp = (my_turn == 'b') ? white_board : black_board;
+    const ulong wins_now = timed ? (legal & threat_cells(own, opp)) : 0;
+    const ulong blocks = timed ? (legal & threat_cells(opp, own)) : 0;
+    if (timed && (wins_now != 0 || blocks != 0 || root_moves_len == 1)) {
+        const ulong mv = first_move(wins_now ? wins_now : blocks ? blocks : legal);
+        // Keep the trees on the game's path so the next search can still reuse them.
+        for (int i = 0; i < state->tree_count && cfg->reuse; i++) {
+            MctsTree *tree = &state->trees[i];
+            if (tree->nodes && mcts_tree_used(tree) > 0) mcts_tree_advance(tree, black_board, white_board, my_turn);
+        }
+        state->sims = 0;
+        state->value = wins_now ? 1.0 : 0.5;   // 0.5: not searched
+        state->clock_used_ms += (omp_get_wtime() - start) * 1000.0;
+        if (cfg->verbose >= 1) {
+            printf("mcts turn=%c move=%d stop=%s (%s)\n", my_turn, binary2decimal(mv), k_mcts_stop_names[MCTS_STOP_FORCED],
+                   wins_now ? "win" : blocks ? "block" : "only move");
+        }
+        return mv;
+    }
+
+    // Per-move budget: --mcts-time-ms, or a share of what is left on the game clock. The
+    // share assumes about one own move per three empty cells, and unstable positions may
+    // stretch it up to MCTS_CLOCK_STRETCH times (never beyond a quarter of the clock).
+    double soft_ms = (cfg->time_ms > 0) ? (double)cfg->time_ms : 0.0;
+    double hard_ms = soft_ms;
+    double clock_left_ms = 0.0;
+    if (cfg->game_time_ms > 0) {
+        clock_left_ms = fmax((double)cfg->game_time_ms - state->clock_used_ms, 0.0);
+        const int empties = 64 - __builtin_popcountl(black_board | white_board);
+        const int moves_left = (empties / 3 > MCTS_CLOCK_MIN_MOVES) ? empties / 3 : MCTS_CLOCK_MIN_MOVES;
+        const double plan = fmax(clock_left_ms / (double)moves_left, 1.0);
+        const double cap = fmax(plan, fmin(plan * MCTS_CLOCK_STRETCH, clock_left_ms / 4.0));
+        soft_ms = (cfg->time_ms > 0) ? fmin(plan, soft_ms) : plan;
+        hard_ms = (cfg->time_ms > 0) ? fmin(cap, hard_ms) : cap;
+    }
+    const double end_time = (hard_ms > 0.0) ? (start + hard_ms / 1000.0) : 1e300;
+
     const uint64_t base_seed = (cfg->seed != 0) ? cfg->seed : auto_seed64();
 
     long long total_visits[16];
     double total_wins[16];
+    int proofs[16];
     for (int i = 0; i < root_moves_len; i++) {
         total_visits[i] = 0;
         total_wins[i] = 0.0;
+        proofs[i] = MCTS_PROOF_NONE;
+    }
+
+    // Node budget per tree: a shared tree gets the whole budget, private trees split it.
+    // With the auto budget the pool also grows by the nodes kept from the previous move.
+    const int trees = shared ? 1 : threads;
+    const long long max_tree_nodes = (8000000LL * (threads / trees) < MCTS_MAX_TREE_NODES)
+                                         ? 8000000LL * (threads / trees) : MCTS_MAX_TREE_NODES;
+    long long tree_nodes;
+    if (cfg->max_nodes > 0) {
+        tree_nodes = cfg->max_nodes;
+    } else if (cfg->iterations > 0) {
+        tree_nodes = (cfg->iterations + trees - 1) / trees + 2048;
+    } else {
+        tree_nodes = 400000LL * (threads / trees);
     }
+    if (tree_nodes < 4096) tree_nodes = 4096;
+    if (tree_nodes > max_tree_nodes) tree_nodes = max_tree_nodes;
+
+    if (state->tree_count != trees) {
+        mcts_state_free(state);
+        state->trees = (MctsTree*)calloc((size_t)trees, sizeof(MctsTree));
+        state->tree_count = state->trees ? trees : 0;
+    }
+
+    long long sims_done = 0;
+    long long nodes_used_sum = 0;
+    long long nodes_reused_sum = 0;
+    MctsTimeCtl tm = {
+        .reason = MCTS_STOP_LIMIT,
+        .start = start,
+        .soft_end = (soft_ms > 0.0) ? (start + soft_ms / 1000.0) : 1e300,
+        .hard_end = end_time,
+        .next_check = start + MCTS_TM_INTERVAL,
+        .iter_target = iter_target,
+        .sims_done = &sims_done,
+        .trees = state->trees,
+        .tree_count = state->tree_count,
+        .root_moves = root_moves,
+        .root_moves_len = root_moves_len,
+        .last_best = -1,
+    };
+
+    #pragma omp parallel num_threads(threads)
+    {
+        const int tid = omp_get_thread_num();
+        Rng rng;
+        rng_seed(&rng, base_seed + (uint64_t)tid * UINT64_C(0x9e3779b97f4a7c15));
+
+        MctsTree *tree = NULL;
+        if (shared) {
+            #pragma omp single
+            {
+                if (state->tree_count > 0) {
+                    const long long kept = mcts_tree_prepare(&state->trees[0], tree_nodes, cfg->max_nodes <= 0, max_tree_nodes,
+                                                             black_board, white_board, my_turn, cfg->reuse != 0, cfg->rave != 0);
+                    if (kept < 0) {
+                        // OOM: best-effort fallback to a random legal move.
+                        if (cfg->verbose >= 1) {
+                            fprintf(stderr, "mcts: OOM (shared tree), falling back to random.\n");
+                        }
+                    } else {
+                        nodes_reused_sum = kept;
+                    }
+                }
+            }
+            if (state->tree_count > 0 && state->trees[0].nodes) tree = &state->trees[0];
+        } else if (tid < state->tree_count) {
+            tree = &state->trees[tid];
+            const long long kept = mcts_tree_prepare(tree, tree_nodes, cfg->max_nodes <= 0, max_tree_nodes,
+                                                     black_board, white_board, my_turn, cfg->reuse != 0, cfg->rave != 0);
+            if (kept < 0) {
+                tree = NULL;
+                // OOM: best-effort fallback to a random legal move.
+                #pragma omp critical
+                {
+                    if (cfg->verbose >= 1) {
+                        fprintf(stderr, "mcts: OOM (thread=%d), falling back to random.\n", tid);
+                    }
+                }
+            } else {
+                #pragma omp atomic
+                nodes_reused_sum += kept;
+            }
+        }
+
+        // The time manager reads every tree, so all of them must be ready first.
+        #pragma omp barrier
+        if (tree) {
+            mcts_search(tree, cfg, end_time, iter_target, &sims_done, &rng, &tm, tid == 0);
+        }
+        if (tree && !shared) {
+            mcts_accumulate_root(tree, root_moves, root_moves_len, total_visits, total_wins, proofs);
+
+            #pragma omp atomic
+            nodes_used_sum += (long long)mcts_tree_used(tree);
+        }
+    }
+
+    state->sims = sims_done;
+    if (shared && state->tree_count > 0 && state->trees[0].nodes) {
+        mcts_accumulate_root(&state->trees[0], root_moves, root_moves_len, total_visits, total_wins, proofs);
+        nodes_used_sum = (long long)mcts_tree_used(&state->trees[0]);
+    }
+
+    // Choose by max visits; tie-break by winrate. A proven win beats any unproven move,
+    // and a proven loss is played only when every move is one.
+    int best_i = 0;
+    int best_rank = -1;
+    long long best_v = -1;
+    double best_wr = -1.0;
+    for (int i = 0; i < root_moves_len; i++) {
+        const long long v = total_visits[i];
+        const double wr = (v > 0) ? (total_wins[i] / (double)v) : 0.0;
+        const int rank = (proofs[i] & MCTS_PROOF_WIN) ? 2 : (proofs[i] & MCTS_PROOF_LOSS) ? 0 : 1;
+        if (rank > best_rank || (rank == best_rank && (v > best_v || (v == best_v && wr > best_wr)))) {
+            best_rank = rank;
+            best_v = v;
+            best_wr = wr;
+            best_i = i;
+        }
+    }
+
+    const double elapsed_ms = (omp_get_wtime() - start) * 1000.0;
+    state->clock_used_ms += elapsed_ms;
+    if (cfg->verbose >= 1) {
+        printf("mcts turn=%c sims=%lld time=%.1fms threads=%d parallel=%s C=%.6f rollout_depth=%d nodes=%lld reused=%lld mem=%.1fMB stop=%s\n",
+               my_turn, sims_done, elapsed_ms, threads, shared ? "tree" : "root", cfg->c, cfg->rollout_max_depth,
+               nodes_used_sum, nodes_reused_sum, (double)nodes_used_sum * (double)(sizeof(MctsNode) + (cfg->rave ? sizeof(MctsAmaf) : 0)) / (1024.0 * 1024.0),
+               k_mcts_stop_names[tm.reason]);
+        if (cfg->game_time_ms > 0) {
+            printf("mcts clock: left=%.0fms plan=%.0fms cap=%.0fms\n", clock_left_ms - elapsed_ms, soft_ms, hard_ms);
+        }
+        for (int i = 0; i < root_moves_len; i++) {
+            const long long v = total_visits[i];
+            const double wr = (v > 0) ? (total_wins[i] / (double)v) : 0.0;
+            printf("  move=%2d visits=%8lld winrate=%.4f%s\n", binary2decimal(root_moves[i]), v, wr,
+                   (proofs[i] & MCTS_PROOF_WIN) ? " proven=win" : (proofs[i] & MCTS_PROOF_LOSS) ? " proven=loss" : "");
+        }
+    }
+
+    state->value = (best_rank == 2) ? 1.0 : (best_rank == 0) ? 0.0 : best_wr;
+    return root_moves[best_i];
+}
+
+// The line through `first` that the last search of `state` visited most (first tree only).
+static int mcts_pv(const MctsState *state, ulong first, int pv[], int max_len) {
+    if (state->tree_count <= 0 || !state->trees[0].nodes || max_len <= 0) return 0;
+    const MctsNode *nodes = state->trees[0].nodes;
+    pv[0] = binary2decimal(first);
+    int n = 1;
+    uint32_t cur = 0;
+    for (uint32_t ci = mcts_first_child(&nodes[0]); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+        if (mcts_node_move(&nodes[ci]) == first) {
+            cur = ci;
+            break;
+        }
+    }
+    while (cur != 0 && n < max_len) {
+        uint32_t best = 0;
+        uint32_t best_v = 0;
+        for (uint32_t ci = mcts_first_child(&nodes[cur]); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+            if (nodes[ci].visits > best_v) {
+                best_v = nodes[ci].visits;
+                best = ci;
+            }
+        }
+        if (best == 0) break;
+        pv[n++] = binary2decimal(mcts_node_move(&nodes[best]));
+        cur = best;
+    }
+    return n;
+}
+
+// ----------------------------
+// Opening book (--book, --book-build)
+// ----------------------------
+// The book file is a header followed by entries sorted by (black, white), in host byte
+// order. Positions are stored in canonical form, so one entry covers all 8 images; the
+// move is a cell index in the canonical frame. The file is mapped read-only and looked
+// up with a binary search, so loading costs nothing beyond the mmap.
+#define BOOK_MAGIC "SF4BOOK1"
+
+typedef struct {
+    char magic[8];
+    uint32_t count;
+    uint16_t max_ply;
+    uint16_t depth;
+} BookHeader;
+
+typedef struct {
+    uint64_t black;            // canonical position
+    uint64_t white;
+    int16_t score;             // minimax score for the side to move
+    uint8_t move;              // best move, canonical frame
+    uint8_t depth;             // search depth behind the score
+    uint32_t reserved;
+} BookEntry;
+
+typedef struct {
+    void *map;
+    size_t bytes;
+    const BookHeader *header;
+    const BookEntry *entries;
+    size_t count;
+} Book;
+
+static Book g_book = {0};
+
+static bool book_open(const char *path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BookHeader)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const BookHeader *header = (const BookHeader*)map;
+    if (memcmp(header->magic, BOOK_MAGIC, sizeof(header->magic)) != 0 ||
+        (size_t)st.st_size != sizeof(BookHeader) + (size_t)header->count * sizeof(BookEntry)) {
+        munmap(map, (size_t)st.st_size);
+        return false;
+    }
+    g_book.map = map;
+    g_book.bytes = (size_t)st.st_size;
+    g_book.header = header;
+    g_book.entries = (const BookEntry*)(header + 1);
+    g_book.count = header->count;
+    return true;
+}
+
+static inline int book_compare(ulong black_a, ulong white_a, ulong black_b, ulong white_b) {
+    if (black_a != black_b) return (black_a < black_b) ? -1 : 1;
+    if (white_a != white_b) return (white_a < white_b) ? -1 : 1;
+    return 0;
+}
+
+static const BookEntry *book_find(ulong black, ulong white) {
+    size_t lo = 0, hi = g_book.count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const BookEntry *e = &g_book.entries[mid];
+        const int cmp = book_compare(e->black, e->white, black, white);
+        if (cmp == 0) return e;
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+// Looks the position up and, on a hit searched to at least `min_depth`, stores the book
+// move (mapped back to the position's own orientation) in *move.
+static bool book_act(const ulong black_board, const ulong white_board, int min_depth, bool verbose, ulong *move) {
+    if (g_book.count == 0) return false;
+    ulong cb, cw;
+    const int t = sym_canonicalize(black_board, white_board, &cb, &cw);
+    const BookEntry *e = book_find(cb, cw);
+    if (!e || e->depth < min_depth) return false;
+    const ulong mv = decimal2binary(g_sym_cell[g_sym_inverse[t]][e->move]);
+    if ((mv & get_possible_pos_board(black_board, white_board)) == 0) return false;
+    if (verbose) {
+        printf("book move=%d score=%d depth=%d\n", binary2decimal(mv), e->score, e->depth);
+    }
+    *move = mv;
+    return true;
+}
+
+static int book_entry_cmp(const void *a, const void *b) {
+    const BookEntry *x = (const BookEntry*)a;
+    const BookEntry *y = (const BookEntry*)b;
+    return book_compare(x->black, x->white, y->black, y->white);
+}
+
+// Sorts entries[0..n) and drops duplicates; returns the new count.
+static size_t book_sort_unique(BookEntry *entries, size_t n) {
+    if (n == 0) return 0;
+    qsort(entries, n, sizeof(BookEntry), book_entry_cmp);
+    size_t out = 1;
+    for (size_t i = 1; i < n; i++) {
+        if (book_entry_cmp(&entries[out - 1], &entries[i]) != 0) entries[out++] = entries[i];
+    }
+    return out;
+}
+
+// Collects every unfinished position up to `max_ply`, one canonical entry per symmetry
+// class, breadth-first so each ply is deduplicated before it is expanded. Returns the
+// number of entries (sorted per ply), or 0 when out of memory.
+static size_t book_enumerate(int max_ply, BookEntry **out) {
+    size_t cap = 1024, count = 0;
+    BookEntry *all = (BookEntry*)calloc(cap, sizeof(BookEntry));
+    if (!all) return 0;
+    all[count++] = (BookEntry){0};
+    size_t level_begin = 0;
+    for (int ply = 0; ply < max_ply; ply++) {
+        const size_t level_end = count;
+        const char turn = (ply & 1) ? 'w' : 'b';
+        for (size_t i = level_begin; i < level_end; i++) {
+            const ulong black = all[i].black, white = all[i].white;
+            ulong moves = get_possible_pos_board(black, white);
+            while (moves) {
+                const ulong mv = first_move(moves);
+                moves ^= mv;
+                ulong nb = black, nw = white;
+                if (turn == 'b') nb |= mv; else nw |= mv;
+                if (which_is_win(nb, nw) != 'n') continue;
+                if (count == cap) {
+                    BookEntry *grown = (BookEntry*)realloc(all, cap * 2 * sizeof(BookEntry));
+                    if (!grown) {
+                        free(all);
+                        return 0;
+                    }
+                    all = grown;
+                    cap *= 2;
+                }
+                BookEntry *e = &all[count++];
+                memset(e, 0, sizeof(*e));
+                sym_canonicalize(nb, nw, &nb, &nw);
+                e->black = nb;
+                e->white = nw;
+            }
+        }
+        count = level_end + book_sort_unique(all + level_end, count - level_end);
+        level_begin = level_end;
+    }
+    *out = all;
+    return count;
+}
+
+// Builds a book of every position up to `max_ply` searched to `depth` and writes it to
+// `path`. Positions are searched one after another, each with the YBW root split over
+// `threads`, so later positions reuse the transposition table filled by earlier ones.
+static bool book_build(const char *path, int max_ply, int depth, int threads) {
+    if (threads <= 0) threads = omp_get_max_threads();
+    if (max_ply < 0) max_ply = 0;
+    if (max_ply > 63) max_ply = 63;
+    if (depth < 1) depth = 1;
+    if (depth > 64) depth = 64;
+    BookEntry *entries = NULL;
+    const size_t n = book_enumerate(max_ply, &entries);
+    if (n == 0) {
+        fprintf(stderr, "Error: out of memory while enumerating book positions.\n");
+        return false;
+    }
+    printf("book: %zu positions up to ply %d, depth %d, threads %d\n", n, max_ply, depth, threads);
+
+    const double start = omp_get_wtime();
+    double last_report = start;
+    long long nodes = 0;
+    for (size_t i = 0; i < n; i++) {
+        BookEntry *e = &entries[i];
+        const int ply = __builtin_popcountl(e->black | e->white);
+        const char turn = (ply & 1) ? 'w' : 'b';
+        ulong next_boards[16][2];
+        int scores[16];
+        bool exact[16];
+        int len = 0;
+        TTHit hit;
+        const int pv_move = tt_probe(tt_pos(e->black, e->white), &hit) ? hit.move : -1;
+        SearchCtx ctx = { .generation = tt_new_search() };
+        const int best_i = minmax_root(&ctx, e->black, e->white, turn, depth, pv_move, threads,
+                                       next_boards, scores, exact, &len);
+        nodes += ctx.nodes;
+        if (best_i < 0) continue;
+        e->move = (uint8_t)binary2decimal((e->black | e->white) ^ (next_boards[best_i][0] | next_boards[best_i][1]));
+        e->score = (int16_t)scores[best_i];
+        e->depth = (uint8_t)depth;
+        tt_store(tt_pos(e->black, e->white), ctx.generation, depth + 1, TT_BOUND_EXACT, e->score, e->move);
+
+        const double now = omp_get_wtime();
+        if (now - last_report >= 1.0) {
+            printf("book: %zu/%zu ply=%d nodes=%lld time=%.1fs\n", i + 1, n, ply, nodes, now - start);
+            fflush(stdout);
+            last_report = now;
+        }
+    }
+    qsort(entries, n, sizeof(BookEntry), book_entry_cmp);
+
+    const BookHeader header = {
+        .magic = BOOK_MAGIC,
+        .count = (uint32_t)n,
+        .max_ply = (uint16_t)max_ply,
+        .depth = (uint16_t)depth,
+    };
+    FILE *fp = fopen(path, "wb");
+    bool ok = (fp != NULL);
+    if (ok) ok = (fwrite(&header, sizeof(header), 1, fp) == 1) && (fwrite(entries, sizeof(BookEntry), n, fp) == n);
+    if (fp && fclose(fp) != 0) ok = false;
+    free(entries);
+    if (!ok) {
+        fprintf(stderr, "Error: could not write book file '%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    const double elapsed = omp_get_wtime() - start;
+    printf("book: wrote %zu positions to %s (%zu bytes) nodes=%lld time=%.1fs nps=%.0f\n",
+           n, path, sizeof(header) + n * sizeof(BookEntry), nodes, elapsed,
+           (elapsed > 0.0) ? ((double)nodes / elapsed) : 0.0);
+    return true;
+}
+
+// ----------------------------
+// Pondering (--ponder)
+// ----------------------------
+// While a human thinks, the engine that moves next keeps searching on a background
+// thread. MCTS searches the human's position itself: the tree spreads over every reply,
+// most of it under the likely one, and once the reply is known mcts_act() keeps that
+// child's subtree (with --mcts-no-reuse there is nothing to keep, so it does not ponder).
+// Minimax takes the reply stored in the transposition table as its guess and deepens on
+// the position after it. On a hit the next search finds those iterations in the table;
+// on a miss, entries for transposed positions still help.
+typedef struct {
+    char player;               // 'm' or 'c'
+    char turn;                 // side of the pondering engine
+    ulong black;               // position searched
+    ulong white;
+    ulong predicted;           // guessed reply (minimax); 0 for MCTS until ponder_stop()
+    MinimaxConfig minimax;
+    MctsConfig mcts;
+    MctsState *state;
+    int stop;
+    long long nodes;
+    double start;
+    pthread_t thread;
+} Ponder;
+
+static void *ponder_search(void *arg) {
+    Ponder *p = (Ponder*)arg;
+    if (p->player == 'm') {
+        p->minimax.nodes = &p->nodes;
+        minmax_act(p->black, p->white, p->turn, &p->minimax);
+    } else {
+        // Pondering runs on the opponent's time, so it does not count against our clock.
+        const double clock_used_ms = p->state->clock_used_ms;
+        mcts_act(p->black, p->white, convert_turn(p->turn), &p->mcts, p->state);
+        p->state->clock_used_ms = clock_used_ms;
+        p->nodes = p->state->sims;
+    }
+    return NULL;
+}
+
+// Starts pondering for `player`, who moves as `turn` after the human's reply at
+// (black, white). Returns false when there is nothing to ponder on.
+static bool ponder_start(Ponder *p, char player, char turn, ulong black, ulong white,
+                         const MinimaxConfig *minimax, const MctsConfig *mcts, MctsState *state) {
+    memset(p, 0, sizeof(*p));
+    p->player = player;
+    p->turn = turn;
+    p->black = black;
+    p->white = white;
+    p->state = state;
+    if (player == 'm') {
+        TTHit hit;
+        if (!tt_probe(tt_pos(black, white), &hit) || hit.move < 0) return false;
+        const ulong mv = decimal2binary(hit.move);
+        if ((mv & get_possible_pos_board(black, white)) == 0) return false;
+        if (turn == 'b') p->white |= mv; else p->black |= mv;
+        if (which_is_win(p->black, p->white) != 'n') return false;
+        p->predicted = mv;
+        p->minimax = *minimax;
+        p->minimax.depth = 0;
+        p->minimax.time_ms = 0;
+        p->minimax.verbose = 0;
+        p->minimax.stop = &p->stop;
+        p->minimax.on_iteration = NULL;
+    } else {
+        if (!mcts->reuse) return false;
+        p->mcts = *mcts;
+        p->mcts.iterations = 0;
+        p->mcts.time_ms = 0;
+        p->mcts.game_time_ms = 0;
+        p->mcts.verbose = 0;
+        p->mcts.stop = &p->stop;
+    }
+    p->start = omp_get_wtime();
+    return pthread_create(&p->thread, NULL, ponder_search, p) == 0;
+}
+
+// Ends the search once the human has played `move` and reports whether it was foreseen.
+static void ponder_stop(Ponder *p, ulong move) {
+    __atomic_store_n(&p->stop, 1, __ATOMIC_RELAXED);
+    pthread_join(p->thread, NULL);
+    const double elapsed = omp_get_wtime() - p->start;
+    if (p->player == 'c') {
+        // The reply the trees spent the most visits on.
+        long long visits[64] = {0};
+        for (int t = 0; t < p->state->tree_count; t++) {
+            const MctsNode *nodes = p->state->trees[t].nodes;
+            if (!nodes) continue;
+            for (uint32_t ci = mcts_first_child(&nodes[0]); ci != 0; ci = mcts_next_sibling(&nodes[ci])) {
+                visits[binary2decimal(mcts_node_move(&nodes[ci]))] += nodes[ci].visits;
+            }
+        }
+        long long best = 0;
+        for (int i = 0; i < 64; i++) {
+            if (visits[i] > best) {
+                best = visits[i];
+                p->predicted = decimal2binary(i);
+            }
+        }
+    }
+    printf("ponder: %s predicted=%d nodes=%lld time=%.1fms\n", (move == p->predicted) ? "hit" : "miss",
+           binary2decimal(p->predicted), p->nodes, elapsed * 1000.0);
+}
+
+void game_start(char player1, char player2, bool enable_show_board, bool enable_show_result, bool enable_ponder,
+                const MinimaxConfig *minimax1, const MinimaxConfig *minimax2, const MctsConfig *mcts1, const MctsConfig *mcts2, uint64_t rng_seed64) {
+    ulong black_board = 0;
+    ulong white_board = 0;
+    char now_player = player1;
+    char now_player_turn = 'b';
+    char result = 'n';
+    Rng game_rng;
+    rng_seed(&game_rng, rng_seed64);
+    MctsState mcts_state1 = {0};
+    MctsState mcts_state2 = {0};
+
+    while (result == 'n') {
+        unsigned long act = 0;
+        printf("turn: %c %c\n", now_player_turn, now_player);
+        if (now_player == 'h') {
+            // The engine to move next (if any) searches while the human thinks.
+            const char engine = (now_player_turn == 'b') ? player2 : player1;
+            const char engine_turn = convert_turn(now_player_turn);
+            Ponder ponder;
+            const bool pondering = enable_ponder && (engine == 'm' || engine == 'c')
+                && ponder_start(&ponder, engine, engine_turn, black_board, white_board,
+                                (engine_turn == 'b') ? minimax1 : minimax2, (engine_turn == 'b') ? mcts1 : mcts2,
+                                (engine_turn == 'b') ? &mcts_state1 : &mcts_state2);
+            act = human_act(black_board, white_board);
+            if (pondering) {
+                ponder_stop(&ponder, act);
+            }
+        } else if (now_player == 'r') {
+            act = random_act(black_board, white_board, &game_rng);
+        } else if (now_player == 'm') {
+            const MinimaxConfig *cfg = (now_player_turn == 'b') ? minimax1 : minimax2;
+            // A depth-limited player only takes book moves searched at least as deep.
+            if (!book_act(black_board, white_board, (cfg->time_ms <= 0) ? cfg->depth : 0, cfg->verbose >= 1, &act)) {
+                act = minmax_act(black_board, white_board, now_player_turn, cfg);
+            }
+        } else if (now_player == 'c') {
+            const MctsConfig *cfg = (now_player_turn == 'b') ? mcts1 : mcts2;
+            MctsState *state = (now_player_turn == 'b') ? &mcts_state1 : &mcts_state2;
+            if (!book_act(black_board, white_board, 0, cfg->verbose >= 1, &act)) {
+                act = mcts_act(black_board, white_board, now_player_turn, cfg, state);
+            }
+        }
+
+        if (now_player_turn == 'b') {
+            printf("black put %d\n", binary2decimal(act));
+        } else if (now_player_turn == 'w') {
+            printf("white put %d\n", binary2decimal(act));
+        }
+
+        if (now_player_turn == 'b') {
+            black_board = black_board | act;
+        } else if (now_player_turn == 'w') {
+            white_board = white_board | act;
+        }
+
+        if (enable_show_board) {
+            print_board(black_board, white_board);
+        }
+
+        now_player_turn = convert_turn(now_player_turn);
+        if (now_player_turn == 'b') {
+            now_player = player1;
+        } else {
+            now_player = player2;
+        }
+
+        result = which_is_win(black_board, white_board);
+    }
+    mcts_state_free(&mcts_state1);
+    mcts_state_free(&mcts_state2);
+    if (enable_show_result) {
+        if (result == 'w') {
+            printf("winner is white!\n");
+        } else if (result == 'b') {
+            printf("winner is black!\n");
+        } else {
+            printf("draw!\n");
+        }
+    }
+}
+
+// ----------------------------
+// Tournament (--tournament N)
+// ----------------------------
+// Plays N games between player A (the --player1 settings) and player B (the --player2
+// settings) with no per-move output. Games 2k and 2k+1 start from the same random
+// opening with colors swapped. The search keeps its state (transposition table, stop
+// flags) in globals, so games run in forked worker processes rather than threads; each
+// worker plays every workers-th game and writes one record per game to a shared pipe.
+typedef struct {
+    char type;                 // 'm', 'c' or 'r'
+    MinimaxConfig minimax;
+    MctsConfig mcts;
+} TournamentPlayer;
+
+// One finished game. Index [0] is player A, [1] is player B. Small enough for a single
+// atomic pipe write (PIPE_BUF).
+typedef struct {
+    uint32_t game;
+    char winner;               // 'a', 'b' or 'd'
+    uint8_t a_black;
+    uint16_t plies;
+    int32_t moves[2];
+    long long nodes[2];        // minimax nodes or MCTS simulations
+    double seconds[2];
+} TournamentGame;
+
+static int tournament_describe(const TournamentPlayer *p, char *buf, size_t len) {
+    if (p->type == 'm') {
+        if (p->minimax.time_ms > 0) {
+            return snprintf(buf, len, "m(time_ms=%d depth=%d)", p->minimax.time_ms, p->minimax.depth);
+        }
+        return snprintf(buf, len, "m(depth=%d)", p->minimax.depth);
+    }
+    if (p->type == 'c') {
+        return snprintf(buf, len, "c(iterations=%lld time_ms=%d game_time_ms=%d C=%.3f parallel=%s)",
+                        p->mcts.iterations, p->mcts.time_ms, p->mcts.game_time_ms, p->mcts.c,
+                        (p->mcts.parallel == MCTS_PARALLEL_TREE) ? "tree" : "root");
+    }
+    return snprintf(buf, len, "r");
+}
+
+// Plays one game from a random opening of `random_plies` moves. players[0] is black.
+// Returns 'b', 'w' or 'd' and adds each side's moves, nodes and time (opening excluded).
+static char tournament_game(const TournamentPlayer *players[2], int random_plies, uint64_t opening_seed,
+                            uint64_t game_seed, int moves[2], long long nodes[2], double seconds[2], int *plies) {
+    ulong black_board = 0;
+    ulong white_board = 0;
+    char turn = 'b';
+    char result = 'n';
+    Rng rng;
+    rng_seed(&rng, opening_seed);
+    for (int i = 0; i < random_plies && result == 'n'; i++) {
+        const ulong act = random_act(black_board, white_board, &rng);
+        if (turn == 'b') black_board |= act; else white_board |= act;
+        turn = convert_turn(turn);
+        result = which_is_win(black_board, white_board);
+    }
+
+    rng_seed(&rng, game_seed);
+    MctsConfig mcts[2];
+    MctsState states[2] = {{0}};
+    for (int s = 0; s < 2; s++) {
+        mcts[s] = players[s]->mcts;
+        mcts[s].seed = rng_next_u64(&rng) | 1;
+    }
+    // Positions from the previous game must not leak into this one.
+    tt_clear();
+
+    *plies = random_plies;
+    while (result == 'n') {
+        const int s = (turn == 'b') ? 0 : 1;
+        const TournamentPlayer *p = players[s];
+        ulong act = 0;
+        long long n = 0;
+        const double start = omp_get_wtime();
+        if (p->type == 'r') {
+            act = random_act(black_board, white_board, &rng);
+        } else if (p->type == 'm') {
+            if (!book_act(black_board, white_board, (p->minimax.time_ms <= 0) ? p->minimax.depth : 0, false, &act)) {
+                MinimaxConfig minimax = p->minimax;
+                minimax.nodes = &n;
+                act = minmax_act(black_board, white_board, turn, &minimax);
+            }
+        } else {
+            if (!book_act(black_board, white_board, 0, false, &act)) {
+                act = mcts_act(black_board, white_board, turn, &mcts[s], &states[s]);
+                n = states[s].sims;
+            }
+        }
+        seconds[s] += omp_get_wtime() - start;
+        nodes[s] += n;
+        moves[s]++;
+        (*plies)++;
+
+        if (turn == 'b') black_board |= act; else white_board |= act;
+        turn = convert_turn(turn);
+        result = which_is_win(black_board, white_board);
+    }
+    mcts_state_free(&states[0]);
+    mcts_state_free(&states[1]);
+    return result;
+}
+
+static void tournament_worker(const TournamentPlayer *a, const TournamentPlayer *b, int games, int worker,
+                              int workers, int random_plies, uint64_t seed, int fd) {
+    for (int g = worker; g < games; g += workers) {
+        TournamentGame rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.game = (uint32_t)g;
+        rec.a_black = (g & 1) == 0;
+        // Both games of a pair share the opening; every game gets its own search seed.
+        uint64_t x = seed + (uint64_t)(g / 2);
+        const uint64_t opening_seed = splitmix64_next(&x);
+        x = seed ^ ((uint64_t)g * UINT64_C(0xd1b54a32d192ed03));
+        const uint64_t game_seed = splitmix64_next(&x);
+
+        const TournamentPlayer *players[2] = { rec.a_black ? a : b, rec.a_black ? b : a };
+        int moves[2] = {0, 0};
+        long long nodes[2] = {0, 0};
+        double seconds[2] = {0.0, 0.0};
+        int plies = 0;
+        const char result = tournament_game(players, random_plies, opening_seed, game_seed, moves, nodes, seconds, &plies);
+        const int ai = rec.a_black ? 0 : 1;
+        rec.moves[0] = moves[ai];
+        rec.moves[1] = moves[1 - ai];
+        rec.nodes[0] = nodes[ai];
+        rec.nodes[1] = nodes[1 - ai];
+        rec.seconds[0] = seconds[ai];
+        rec.seconds[1] = seconds[1 - ai];
+        rec.plies = (uint16_t)plies;
+        if (result == 'd') {
+            rec.winner = 'd';
+        } else {
+            rec.winner = ((result == 'b') == (rec.a_black != 0)) ? 'a' : 'b';
+        }
+        if (write(fd, &rec, sizeof(rec)) != (ssize_t)sizeof(rec)) {
+            break;
+        }
+    }
+}
+
+static double elo_from_score(double score) {
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+// Elo of A over B from the game results, with a 95% interval from the per-game score
+// variance (normal approximation). Returns false when one side scored every point, as
+// the estimate is then unbounded.
+static bool tournament_elo(long long wins, long long draws, long long losses, double *elo, double *margin) {
+    const double n = (double)(wins + draws + losses);
+    const double score = ((double)wins + 0.5 * (double)draws) / n;
+    if (score <= 0.0 || score >= 1.0) return false;
+    const double var = ((double)wins * (1.0 - score) * (1.0 - score)
+                        + (double)draws * (0.5 - score) * (0.5 - score)
+                        + (double)losses * score * score) / n;
+    const double dev = 1.959964 * sqrt(var / n);
+    const double eps = 1e-9;
+    const double lo = fmax(score - dev, eps);
+    const double hi = fmin(score + dev, 1.0 - eps);
+    *elo = elo_from_score(score);
+    *margin = (elo_from_score(hi) - elo_from_score(lo)) / 2.0;
+    return true;
+}
+
+static bool tournament_run(const TournamentPlayer *a, const TournamentPlayer *b, int games, int workers,
+                           int random_plies, uint64_t seed) {
+    if (workers <= 0) {
+        const long n = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (n > 0) ? (int)n : 1;
+    }
+    if (workers > games) workers = games;
+
+    char name_a[128], name_b[128];
+    tournament_describe(a, name_a, sizeof(name_a));
+    tournament_describe(b, name_b, sizeof(name_b));
+    printf("tournament: games=%d workers=%d random_plies=%d seed=%" PRIu64 "\n", games, workers, random_plies, seed);
+    printf("A: %s\n", name_a);
+    printf("B: %s\n", name_b);
+    fflush(stdout);
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        fprintf(stderr, "Error: pipe: %s\n", strerror(errno));
+        return false;
+    }
+    const double start = omp_get_wtime();
+    int started = 0;
+    for (int w = 0; w < workers; w++) {
+        const pid_t pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "Error: fork: %s\n", strerror(errno));
+            break;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            tournament_worker(a, b, games, w, workers, random_plies, seed, fds[1]);
+            close(fds[1]);
+            _exit(0);
+        }
+        started++;
+    }
+    close(fds[1]);
+
+    long long wins = 0, draws = 0, losses = 0;
+    long long black_wins = 0, white_wins = 0;
+    long long plies = 0;
+    long long moves[2] = {0, 0};
+    long long nodes[2] = {0, 0};
+    double seconds[2] = {0.0, 0.0};
+    int done = 0;
+    double last_report = start;
+    TournamentGame rec;
+    while (done < games) {
+        const ssize_t r = read(fds[0], &rec, sizeof(rec));
+        if (r < 0 && errno == EINTR) continue;
+        if (r != (ssize_t)sizeof(rec)) break;
+        done++;
+        if (rec.winner == 'a') wins++;
+        else if (rec.winner == 'b') losses++;
+        else draws++;
+        if (rec.winner != 'd') {
+            if ((rec.winner == 'a') == (rec.a_black != 0)) black_wins++; else white_wins++;
+        }
+        plies += rec.plies;
+        for (int s = 0; s < 2; s++) {
+            moves[s] += rec.moves[s];
+            nodes[s] += rec.nodes[s];
+            seconds[s] += rec.seconds[s];
+        }
+        const double now = omp_get_wtime();
+        if (now - last_report >= 1.0 && done < games) {
+            printf("tournament: %d/%d A wins=%lld draws=%lld losses=%lld time=%.1fs\n",
+                   done, games, wins, draws, losses, now - start);
+            fflush(stdout);
+            last_report = now;
+        }
+    }
+    close(fds[0]);
+    for (int w = 0; w < started; w++) {
+        wait(NULL);
+    }
+    if (done < games) {
+        fprintf(stderr, "Error: only %d of %d games finished.\n", done, games);
+        if (done == 0) return false;
+    }
+
+    const double elapsed = omp_get_wtime() - start;
+    double elo, margin;
+    printf("games=%d A wins=%lld draws=%lld losses=%lld score=%.4f\n",
+           done, wins, draws, losses, ((double)wins + 0.5 * (double)draws) / (double)done);
+    if (tournament_elo(wins, draws, losses, &elo, &margin)) {
+        printf("elo(A-B)=%+.1f +/- %.1f (95%%)\n", elo, margin);
+    } else {
+        printf("elo(A-B)=%cinf\n", (wins > losses) ? '+' : '-');
+    }
+    printf("black wins=%lld white wins=%lld draws=%lld avg_plies=%.1f time=%.1fs\n",
+           black_wins, white_wins, draws, (double)plies / (double)done, elapsed);
+    for (int s = 0; s < 2; s++) {
+        printf("%c: moves=%lld avg_time=%.3fms nodes=%lld nps=%.0f\n",
+               (s == 0) ? 'A' : 'B', moves[s], (moves[s] > 0) ? (seconds[s] * 1000.0 / (double)moves[s]) : 0.0,
+               nodes[s], (seconds[s] > 0.0) ? ((double)nodes[s] / seconds[s]) : 0.0);
+    }
+    return done == games;
+}
+
+// ----------------------------
+// Exact solver (--solve, df-pn)
+// ----------------------------
+// Depth-first proof-number search (Nagai, 2002). Stones are only ever added, so the
+// search graph has no cycles and plain (pn, dn) transposition entries are sound.
+// A position is solved with up to two proofs for the side to move: "wins" and, if
+// that is disproven, "does not lose" (draws count as proven).
+#define DFPN_INF UINT32_C(0x7fffffff)
+// Sums saturate one below DFPN_INF (which means decided), so a root search uses this
+// threshold and stops once a sum saturates; the root is then left undecided.
+#define DFPN_ROOT_TH (DFPN_INF - 1)
+
+typedef struct {
+    ulong black;
+    ulong white;
+    uint32_t pn;
+    uint32_t dn;
+    uint32_t work;             // nodes spent below this entry (replacement priority)
+    uint32_t pad;
+} DfpnEntry;
+
+typedef struct {
+    DfpnEntry *entries;        // 2-way buckets
+    uint64_t mask;             // bucket index mask
+    size_t bytes;
+    char attacker;             // side the proof is for
+    bool draw_is_win;          // second pass: a draw proves the attacker's goal
+    long long nodes;
+    double deadline;           // omp_get_wtime() deadline (<=0: none)
+    bool stopped;
+} Dfpn;
+
+static bool dfpn_init(Dfpn *s, long long megabytes) {
+    memset(s, 0, sizeof(*s));
+    uint64_t n = 1;
+    const uint64_t want = ((uint64_t)((megabytes > 0) ? megabytes : 1) << 20) / (2 * sizeof(DfpnEntry));
+    while ((n << 1) <= want) n <<= 1;
+    while (n >= 1024) {
+        s->entries = (DfpnEntry*)calloc((size_t)n * 2, sizeof(DfpnEntry));
+        if (s->entries) break;
+        n >>= 1;
+    }
+    if (!s->entries) return false;
+    s->mask = n - 1;
+    s->bytes = (size_t)n * 2 * sizeof(DfpnEntry);
+    return true;
+}
+
+static inline uint32_t dfpn_add(uint32_t a, uint32_t b) {
+    if (a >= DFPN_INF || b >= DFPN_INF) return DFPN_INF;
+    const uint32_t sum = a + b;
+    return (sum >= DFPN_INF) ? DFPN_INF - 1 : sum;
+}
+
+static inline DfpnEntry *dfpn_probe(Dfpn *s, ulong black, ulong white) {
+    DfpnEntry *bucket = &s->entries[(tt_key(black, white) & s->mask) * 2];
+    for (int i = 0; i < 2; i++) {
+        if (bucket[i].black == black && bucket[i].white == white && bucket[i].work != 0) return &bucket[i];
+    }
+    return NULL;
+}
+
+static void dfpn_store(Dfpn *s, ulong black, ulong white, uint32_t pn, uint32_t dn, uint32_t work) {
+    DfpnEntry *bucket = &s->entries[(tt_key(black, white) & s->mask) * 2];
+    DfpnEntry *e = &bucket[0];
+    if (!(bucket[0].black == black && bucket[0].white == white)) {
+        if ((bucket[1].black == black && bucket[1].white == white) || bucket[1].work < bucket[0].work) e = &bucket[1];
+    }
+    e->black = black;
+    e->white = white;
+    e->pn = pn;
+    e->dn = dn;
+    e->work = (work > 0) ? work : 1;
+}
+
+// Returns the value of a position that is decided within one move ('b', 'w' or 'd' for a
+// full board); otherwise 'n' with the moves worth searching in *moves. The side to move
+// must take an immediate win, must block a single opponent threat and loses to two; a
+// move under an opponent threat hands it the cell above and is dropped if anything else is left.
+static char dfpn_static(ulong black, ulong white, char turn, ulong *moves) {
+    const ulong legal = get_possible_pos_board(black, white);
+    if (legal == 0) return 'd';
+    const ulong own = (turn == 'b') ? black : white;
+    const ulong opp = (turn == 'b') ? white : black;
+    if (threat_cells(own, opp) & legal) return turn;
+    const ulong opp_threats = threat_cells(opp, own);
+    const ulong must = opp_threats & legal;
+    if (must & (must - 1)) return convert_turn(turn);
+    ulong m = (must != 0) ? must : legal;
+    const ulong safe = m & ~(opp_threats << 16);
+    *moves = (safe != 0) ? safe : m;
+    return 'n';
+}
+
+// (pn, dn) of a decided value, or the mobility-based initial estimate of an open position.
+static inline void dfpn_leaf_value(const Dfpn *s, char value, char turn, ulong moves, uint32_t *pn, uint32_t *dn) {
+    if (value != 'n') {
+        const bool proven = (value == s->attacker) || (value == 'd' && s->draw_is_win);
+        *pn = proven ? 0 : DFPN_INF;
+        *dn = proven ? DFPN_INF : 0;
+    } else if (turn == s->attacker) {
+        *pn = 1;
+        *dn = (uint32_t)count_moves(moves);
+    } else {
+        *pn = (uint32_t)count_moves(moves);
+        *dn = 1;
+    }
+}
+
+static inline void dfpn_play(ulong *black, ulong *white, char turn, ulong mv) {
+    if (turn == 'b') *black |= mv; else *white |= mv;
+}
+
+// Multiple iterative deepening: searches below (black, white) until its pn or dn reaches
+// the thresholds, then stores and returns the node's (pn, dn).
+static void dfpn_mid(Dfpn *s, ulong black, ulong white, char turn, uint32_t th_pn, uint32_t th_dn,
+                     uint32_t *out_pn, uint32_t *out_dn) {
+    const long long nodes_before = s->nodes++;
+    if ((s->nodes & 0xfff) == 0 && s->deadline > 0.0 && omp_get_wtime() >= s->deadline) s->stopped = true;
+
+    ulong moves = 0;
+    const char value = dfpn_static(black, white, turn, &moves);
+    uint32_t pn, dn;
+    if (value != 'n') {
+        dfpn_leaf_value(s, value, turn, 0, &pn, &dn);
+        dfpn_store(s, black, white, pn, dn, 1);
+        *out_pn = pn;
+        *out_dn = dn;
+        return;
+    }
+
+    const bool or_node = (turn == s->attacker);
+    const char next_turn = convert_turn(turn);
+    ulong child_boards[16][2];
+    uint32_t cpn[16], cdn[16];
+    int n = 0;
+    for (ulong rest = moves; rest != 0; n++) {
+        const ulong mv = first_move(rest);
+        rest ^= mv;
+        ulong cb = black, cw = white;
+        dfpn_play(&cb, &cw, turn, mv);
+        child_boards[n][0] = cb;
+        child_boards[n][1] = cw;
+        const DfpnEntry *e = dfpn_probe(s, cb, cw);
+        if (e) {
+            cpn[n] = e->pn;
+            cdn[n] = e->dn;
+        } else {
+            ulong child_moves = 0;
+            const char cv = dfpn_static(cb, cw, next_turn, &child_moves);
+            dfpn_leaf_value(s, cv, next_turn, child_moves, &cpn[n], &cdn[n]);
+        }
+    }
+
+    while (1) {
+        // OR node: pn = min, dn = sum over children; AND node: the other way round.
+        uint32_t best_val = DFPN_INF + 1, second_val = DFPN_INF;
+        uint32_t sum = 0;
+        int best = 0;
+        for (int i = 0; i < n; i++) {
+            const uint32_t v = or_node ? cpn[i] : cdn[i];
+            sum = dfpn_add(sum, or_node ? cdn[i] : cpn[i]);
+            if (v < best_val) {
+                second_val = best_val;
+                best_val = v;
+                best = i;
+            } else if (v < second_val) {
+                second_val = v;
+            }
+        }
+        if (second_val > DFPN_INF) second_val = DFPN_INF;
+        pn = or_node ? best_val : sum;
+        dn = or_node ? sum : best_val;
+        if (pn >= th_pn || dn >= th_dn || s->stopped) break;
+
+        uint32_t cth_pn, cth_dn;
+        if (or_node) {
+            cth_pn = (th_pn < dfpn_add(second_val, 1)) ? th_pn : dfpn_add(second_val, 1);
+            cth_dn = th_dn - dn + cdn[best];
+        } else {
+            cth_dn = (th_dn < dfpn_add(second_val, 1)) ? th_dn : dfpn_add(second_val, 1);
+            cth_pn = th_pn - pn + cpn[best];
+        }
+        dfpn_mid(s, child_boards[best][0], child_boards[best][1], next_turn, cth_pn, cth_dn, &cpn[best], &cdn[best]);
+    }
+
+    const long long work = s->nodes - nodes_before;
+    dfpn_store(s, black, white, pn, dn, (work < (long long)UINT32_MAX) ? (uint32_t)work : UINT32_MAX);
+    *out_pn = pn;
+    *out_dn = dn;
+}
+
+// (pn, dn, work) of a child on the solution line. With `search`, a child that is missing
+// from the table or still open is solved first.
+static void dfpn_resolve(Dfpn *s, ulong black, ulong white, char turn, bool search,
+                         uint32_t *pn, uint32_t *dn, uint32_t *work) {
+    const DfpnEntry *e = dfpn_probe(s, black, white);
+    if (search && (!e || (e->pn != 0 && e->dn != 0))) {
+        dfpn_mid(s, black, white, turn, DFPN_ROOT_TH, DFPN_ROOT_TH, pn, dn);
+        e = dfpn_probe(s, black, white);
+    }
+    if (e) {
+        *pn = e->pn;
+        *dn = e->dn;
+        *work = e->work;
+    } else {
+        *work = 0;
+    }
+}
+
+// Follows the proof (proven) or disproof from the root and writes the moves into line[].
+// The side whose goal holds plays its quickest solved child (smallest subtree); the other
+// side resists with the child that took the most work to solve.
+static int dfpn_line(Dfpn *s, ulong black, ulong white, char turn, bool proven, int line[64]) {
+    int len = 0;
+    while (len < 64) {
+        ulong moves = 0;
+        const char value = dfpn_static(black, white, turn, &moves);
+        if (value == 'd') break;
+        if (value != 'n') {
+            // Decided within a move: the winner plays a winning cell, a loser its first forced move.
+            const ulong own = (turn == 'b') ? black : white;
+            const ulong opp = (turn == 'b') ? white : black;
+            const ulong legal = get_possible_pos_board(black, white);
+            const ulong wins = threat_cells(own, opp) & legal;
+            const ulong must = threat_cells(opp, own) & legal;
+            const ulong mv = first_move((value == turn) ? wins : (must != 0) ? must : legal);
+            line[len++] = binary2decimal(mv);
+            if (value == turn) break;
+            dfpn_play(&black, &white, turn, mv);
+            turn = convert_turn(turn);
+            continue;
+        }
+
+        // The goal side needs only one solved child, so it first looks at the table alone
+        // rather than solving every sibling.
+        const bool goal_side = ((turn == s->attacker) == proven);
+        ulong pick = 0;
+        uint32_t pick_work = 0;
+        for (int attempt = goal_side ? 0 : 1; attempt < 2 && pick == 0; attempt++) {
+            for (ulong rest = moves; rest != 0;) {
+                const ulong mv = first_move(rest);
+                rest ^= mv;
+                ulong cb = black, cw = white;
+                dfpn_play(&cb, &cw, turn, mv);
+                uint32_t pn = DFPN_INF, dn = DFPN_INF, work = 0;
+                dfpn_resolve(s, cb, cw, convert_turn(turn), attempt == 1, &pn, &dn, &work);
+                if ((proven ? pn : dn) != 0) continue;
+                if (pick == 0 || (goal_side ? (work < pick_work) : (work > pick_work))) {
+                    pick = mv;
+                    pick_work = work;
+                }
+            }
+        }
+        if (pick == 0 || s->stopped) break;
+        line[len++] = binary2decimal(pick);
+        dfpn_play(&black, &white, turn, pick);
+        turn = convert_turn(turn);
+    }
+    return len;
+}
+
+// Parses a position: cell indices in play order, black first ("3,19,7" or "3 19 7"; ""
+// or "-" is the empty board), or a bitboard pair "BLACK:WHITE" (strtoull syntax, e.g.
+// 0x8000000000000000:0). The side to move follows from the stone counts.
+static bool parse_position(const char *text, ulong *black_out, ulong *white_out, char *turn_out) {
+    ulong black = 0, white = 0;
+    char turn = 'b';
+    const char *colon = strchr(text, ':');
+    if (colon) {
+        char *end = NULL;
+        errno = 0;
+        black = (ulong)strtoull(text, &end, 0);
+        if (errno != 0 || end != colon) return false;
+        white = (ulong)strtoull(colon + 1, &end, 0);
+        if (errno != 0 || *end != '\0') return false;
+        const int nb = __builtin_popcountl(black), nw = __builtin_popcountl(white);
+        const ulong board = black | white;
+        const ulong first_floor = UINT64_C(0xffff000000000000);
+        if ((black & white) != 0 || (nb != nw && nb != nw + 1)) return false;
+        if ((((board & ~first_floor) << 16) & ~board) != 0) return false; // floating stone
+        turn = (nb == nw) ? 'b' : 'w';
+    } else if (strcmp(text, "-") != 0) {
+        const char *p = text;
+        while (*p != '\0') {
+            if (*p == ',' || *p == ' ') {
+                p++;
+                continue;
+            }
+            char *end = NULL;
+            const long idx = strtol(p, &end, 10);
+            if (end == p || idx < 0 || idx >= 64) return false;
+            p = end;
+            const ulong mv = decimal2binary((int)idx);
+            if (which_is_win(black, white) != 'n' || !is_possible_pos(black, white, mv)) return false;
+            dfpn_play(&black, &white, turn, mv);
+            turn = convert_turn(turn);
+        }
+    }
+    *black_out = black;
+    *white_out = white;
+    *turn_out = turn;
+    return true;
+}
+
+static const char *solve_result_name(char result, char turn) {
+    if (result == 'd') return "draw";
+    return (result == turn) ? "win" : "loss";
+}
 
-    long long sims_done = 0;
-    long long nodes_used_sum = 0;
+// Solves the position and prints the result for the side to move, a solution line and
+// search statistics. Returns false if the time limit ran out first.
+static bool solve_position(ulong black, ulong white, char turn, long long tt_mb, int time_ms, bool show_board) {
+    printf("solve: black=0x%016lx white=0x%016lx turn=%c\n", black, white, turn);
+    if (show_board) print_board(black, white);
+    const char over = which_is_win(black, white);
+    if (over != 'n') {
+        printf("solve: game already over (%s)\n", (over == 'd') ? "draw" : (over == 'b') ? "black won" : "white won");
+        return true;
+    }
 
-    #pragma omp parallel num_threads(threads)
-    {
-        const int tid = omp_get_thread_num();
-        Rng rng;
-        rng_seed(&rng, base_seed + (uint64_t)tid * UINT64_C(0x9e3779b97f4a7c15));
+    Dfpn s;
+    if (!dfpn_init(&s, tt_mb)) {
+        fprintf(stderr, "Error: could not allocate a %lldMB solver table.\n", tt_mb);
+        return false;
+    }
+    s.attacker = turn;
+    const double start = omp_get_wtime();
+    s.deadline = (time_ms > 0) ? start + (double)time_ms / 1000.0 : 0.0;
 
-        long long per_thread_nodes;
-        if (cfg->max_nodes > 0) {
-            per_thread_nodes = cfg->max_nodes;
-        } else if (cfg->iterations > 0) {
-            const long long it_pt = (cfg->iterations + threads - 1) / threads;
-            per_thread_nodes = it_pt + 2048;
-        } else {
-            per_thread_nodes = 100000;
+    char result = 'n';
+    bool proven = false;
+    uint32_t pn = 0, dn = 0;
+    for (int pass = 0; pass < 2 && result == 'n'; pass++) {
+        s.draw_is_win = (pass == 1);
+        if (pass == 1) memset(s.entries, 0, s.bytes);
+        const long long pass_nodes = s.nodes;
+        const double pass_start = omp_get_wtime();
+        dfpn_mid(&s, black, white, turn, DFPN_ROOT_TH, DFPN_ROOT_TH, &pn, &dn);
+        printf("solve: pass=%s pn=%u dn=%u nodes=%lld time=%.1fms\n", (pass == 0) ? "win" : "not-lose",
+               pn, dn, s.nodes - pass_nodes, (omp_get_wtime() - pass_start) * 1000.0);
+        if (s.stopped || (pn != 0 && dn != 0)) break;
+        if (pn == 0) {
+            result = (pass == 0) ? turn : 'd';
+            proven = true;
+        } else if (pass == 1) {
+            result = convert_turn(turn);
         }
-        if (per_thread_nodes < 4096) per_thread_nodes = 4096;
-        if (per_thread_nodes > 2000000) per_thread_nodes = 2000000;
+    }
 
-        MctsNode *nodes = (MctsNode*)calloc((size_t)per_thread_nodes, sizeof(MctsNode));
-        if (!nodes) {
-            // OOM: best-effort fallback to a random legal move.
-            #pragma omp critical
-            {
-                if (cfg->verbose >= 1) {
-                    fprintf(stderr, "mcts: OOM (thread=%d), falling back to random.\n", tid);
-                }
-            }
-        } else {
-            uint32_t node_count = 1;
-            nodes[0].black = black_board;
-            nodes[0].white = white_board;
-            nodes[0].parent = -1;
-            nodes[0].turn = my_turn;
-            nodes[0].result = which_is_win(black_board, white_board);
-
-            long long local_sims = 0;
-            long long pending = 0;
-            while (1) {
-                if ((pending & 0x3f) == 0) {
-                    if (cfg->time_ms > 0 && omp_get_wtime() >= end_time) break;
-                    if (cfg->iterations > 0) {
-                        long long cur;
-                        #pragma omp atomic read
-                        cur = sims_done;
-                        if (cur >= iter_target) break;
-                    }
-                }
+    const long long search_nodes = s.nodes;
+    const double elapsed_s = omp_get_wtime() - start;
+    if (result == 'n') {
+        printf("solve: unknown (%s) pn=%u dn=%u\n", s.stopped ? "time limit" : "proof numbers saturated", pn, dn);
+    } else {
+        int line[64];
+        s.deadline = 0.0;
+        const int len = dfpn_line(&s, black, white, turn, proven, line);
+        printf("solve: result=%s (%c to move)", solve_result_name(result, turn), turn);
+        if (result != 'd') printf(" winner=%c", result);
+        printf("\nline:");
+        for (int i = 0; i < len; i++) printf(" %d", line[i]);
+        printf("\n");
+    }
 
-                uint32_t cur = 0;
-                // Selection
-                while (1) {
-                    MctsNode *n = &nodes[cur];
-                    if (n->result != 'n') break;
-                    ulong legal[16];
-                    const int legal_len = get_possible_poses_binary(n->black, n->white, legal);
-                    if (legal_len == 0) {
-                        n->result = 'd';
-                        break;
-                    }
-                    if (n->child_count < (uint8_t)legal_len && node_count < (uint32_t)per_thread_nodes) {
-                        break; // expandable
-                    }
-                    if (n->child_count == 0) break;
-                    cur = mcts_select_child_uct(nodes, cur, cfg->c);
-                }
+    long long used = 0;
+    for (uint64_t i = 0; i < (s.mask + 1) * 2; i++) used += (s.entries[i].work != 0);
+    printf("solve: nodes=%lld time=%.1fms nps=%.0f tt=%zuMB used=%.1f%%\n",
+           search_nodes, elapsed_s * 1000.0, (elapsed_s > 0.0) ? ((double)search_nodes / elapsed_s) : 0.0,
+           s.bytes >> 20, 100.0 * (double)used / (double)((s.mask + 1) * 2));
+    free(s.entries);
+    return result != 'n';
+}
 
-                // Expansion (at most 1 new node)
-                MctsNode *n = &nodes[cur];
-                if (n->result == 'n' && node_count < (uint32_t)per_thread_nodes) {
-                    ulong legal[16];
-                    const int legal_len = get_possible_poses_binary(n->black, n->white, legal);
-                    if (legal_len > 0 && n->child_count < (uint8_t)legal_len) {
-                        uint32_t start_i = rng_uniform_u32(&rng, (uint32_t)legal_len);
-                        ulong chosen = 0;
-                        for (int k = 0; k < legal_len; k++) {
-                            const ulong mv = legal[(int)((start_i + (uint32_t)k) % (uint32_t)legal_len)];
-                            if (!mcts_move_is_expanded(nodes, cur, mv)) {
-                                chosen = mv;
-                                break;
-                            }
-                        }
-                        if (chosen != 0) {
-                            const uint32_t child = node_count++;
-                            nodes[child].black = n->black;
-                            nodes[child].white = n->white;
-                            nodes[child].parent = (int)cur;
-                            nodes[child].turn = convert_turn(n->turn);
-
-                            if (n->turn == 'b') {
-                                nodes[child].black |= chosen;
-                                if (is_win_after_move(nodes[child].black, chosen)) {
-                                    nodes[child].result = 'b';
-                                }
-                            } else {
-                                nodes[child].white |= chosen;
-                                if (is_win_after_move(nodes[child].white, chosen)) {
-                                    nodes[child].result = 'w';
-                                }
-                            }
-                            if (nodes[child].result == 0) {
-                                nodes[child].result = (get_possible_pos_board(nodes[child].black, nodes[child].white) == 0) ? 'd' : 'n';
-                            }
+// ----------------------------
+// Engine server (--serve, --serve-socket)
+// ----------------------------
+// A line protocol in the spirit of UCI/GTP, one command per line:
+//   isready                                    -> readyok
+//   newgame                                    -> ok (drops the session's MCTS tree)
+//   position startpos|POS [moves I J ...]      -> ok | error ...
+//   go [engine m|c] [depth N] [movetime MS] [iterations N] [infinite]
+//                                              -> info ... lines, then bestmove I
+//   stop                                       -> ends the running search early
+//   quit
+// POS takes the --solve format. A search runs on its own thread so `stop` can be read
+// while it is in progress. The transposition table is shared by every session and stays
+// warm between requests, and each session keeps its MCTS tree from move to move.
+// Searches from different sessions run side by side; each has its own stop flag and
+// node counters.
+#define SERVER_QUEUE 64
 
-                            n->children[n->child_count++] = child;
-                            cur = child;
-                        }
-                    }
-                }
+typedef struct {
+    char engine;               // engine for a `go` that does not pick one: 'm' or 'c'
+    MinimaxConfig minimax;
+    MctsConfig mcts;
+} ServerConfig;
 
-                // Simulation
-                const MctsNode *leaf = &nodes[cur];
-                float value;
-                if (leaf->result != 'n') {
-                    value = reward_from_result(leaf->result, my_turn);
-                } else {
-                    value = mcts_rollout_value(leaf->black, leaf->white, leaf->turn, my_turn, cfg->rollout_max_depth, &rng);
-                }
+typedef struct {
+    const ServerConfig *cfg;
+    int out_fd;
+    pthread_mutex_t out_lock;
+    ulong black;
+    ulong white;
+    char turn;
+    MctsState mcts;
+    pthread_t search_thread;
+    bool searching;
+    int stop;
+    int done;                  // set by the search thread after its bestmove
+    char go_engine;            // settings of the running search
+    MinimaxConfig go_minimax;
+    MctsConfig go_mcts;
+} ServerSession;
+
+// Writes one line to the session; info lines and replies may come from two threads.
+static void server_send(ServerSession *s, const char *fmt, ...) {
+    char buf[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if (n > (int)sizeof(buf) - 2) n = (int)sizeof(buf) - 2;
+    buf[n++] = '\n';
+    pthread_mutex_lock(&s->out_lock);
+    for (int off = 0; off < n; ) {
+        const ssize_t w = write(s->out_fd, buf + off, (size_t)(n - off));
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) break;
+        off += (int)w;
+    }
+    pthread_mutex_unlock(&s->out_lock);
+}
 
-                // Backprop
-                uint32_t bp = cur;
-                while (1) {
-                    nodes[bp].visits++;
-                    // Store wins from the perspective of "the player who just moved into this node".
-                    // For a node, that player is always convert_turn(nodes[bp].turn).
-                    // Rollout value is from the root player's perspective (my_turn), so flip when needed.
-                    if (bp == 0) {
-                        // Root has no "just moved" player; its wins is not used for selection anyway.
-                        nodes[bp].wins += value;
-                    } else {
-                        const char just_moved = convert_turn(nodes[bp].turn);
-                        const float add = (just_moved == my_turn) ? value : (1.0f - value);
-                        nodes[bp].wins += add;
-                    }
-                    if (nodes[bp].parent < 0) break;
-                    bp = (uint32_t)nodes[bp].parent;
-                }
+static void server_format_pv(char *buf, size_t len, const int *pv, int n) {
+    size_t used = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < n && used < len; i++) {
+        const int w = snprintf(buf + used, len - used, " %d", pv[i]);
+        if (w < 0) break;
+        used += (size_t)w;
+    }
+}
 
-                local_sims++;
-                pending++;
-                if ((pending & 0x3f) == 0) {
-                    #pragma omp atomic
-                    sims_done += 64;
-                    pending = 0;
-                }
-                if (cfg->time_ms > 0 && omp_get_wtime() >= end_time) {
-                    break;
-                }
-            }
+static void server_minimax_info(void *arg, int depth, int score, int move, long long nodes, double seconds) {
+    ServerSession *s = (ServerSession*)arg;
+    int pv[64];
+    pv[0] = move;
+    ulong black = s->black, white = s->white;
+    if (s->turn == 'b') black |= decimal2binary(move); else white |= decimal2binary(move);
+    int n = 1;
+    if (which_is_win(black, white) == 'n') n += tt_pv(black, white, convert_turn(s->turn), pv + 1, depth);
+    char line[256];
+    server_format_pv(line, sizeof(line), pv, n);
+    server_send(s, "info depth %d score %d nodes %lld nps %.0f time %.0f pv%s", depth, score, nodes,
+                (seconds > 0.0) ? ((double)nodes / seconds) : 0.0, seconds * 1000.0, line);
+}
 
-            if (pending > 0) {
-                #pragma omp atomic
-                sims_done += pending;
+static void *server_search(void *arg) {
+    ServerSession *s = (ServerSession*)arg;
+    const double start = omp_get_wtime();
+    ulong mv = 0;
+    if (s->go_engine == 'm') {
+        const int min_depth = (s->go_minimax.time_ms <= 0) ? s->go_minimax.depth : 0;
+        if (book_act(s->black, s->white, min_depth, false, &mv)) {
+            server_send(s, "info string book");
+        } else {
+            mv = minmax_act(s->black, s->white, s->turn, &s->go_minimax);
+        }
+    } else if (book_act(s->black, s->white, 0, false, &mv)) {
+        server_send(s, "info string book");
+    } else {
+        mv = mcts_act(s->black, s->white, s->turn, &s->go_mcts, &s->mcts);
+        const double seconds = omp_get_wtime() - start;
+        int pv[64];
+        char line[256];
+        server_format_pv(line, sizeof(line), pv, mcts_pv(&s->mcts, mv, pv, 64));
+        server_send(s, "info nodes %lld nps %.0f time %.0f winrate %.4f pv%s", s->mcts.sims,
+                    (seconds > 0.0) ? ((double)s->mcts.sims / seconds) : 0.0, seconds * 1000.0, s->mcts.value, line);
+    }
+    server_send(s, "bestmove %d", binary2decimal(mv));
+    __atomic_store_n(&s->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Ends the running search (if any) once it has sent its bestmove.
+static void server_stop(ServerSession *s) {
+    if (!s->searching) return;
+    __atomic_store_n(&s->stop, 1, __ATOMIC_RELAXED);
+    pthread_join(s->search_thread, NULL);
+    s->searching = false;
+}
+
+static void server_position(ServerSession *s, char **save) {
+    const char *pos = strtok_r(NULL, " \t\r\n", save);
+    ulong black = 0, white = 0;
+    char turn = 'b';
+    if (!pos || (strcmp(pos, "startpos") != 0 && !parse_position(pos, &black, &white, &turn))) {
+        server_send(s, "error invalid position");
+        return;
+    }
+    const char *tok = strtok_r(NULL, " \t\r\n", save);
+    if (tok && strcmp(tok, "moves") == 0) {
+        while ((tok = strtok_r(NULL, " \t\r\n", save)) != NULL) {
+            char *end = NULL;
+            const long idx = strtol(tok, &end, 10);
+            const ulong mv = (end != tok && *end == '\0') ? decimal2binary((int)idx) : 0;
+            if (mv == 0 || which_is_win(black, white) != 'n' || !is_possible_pos(black, white, mv)) {
+                server_send(s, "error illegal move %s", tok);
+                return;
             }
+            if (turn == 'b') black |= mv; else white |= mv;
+            turn = convert_turn(turn);
+        }
+    } else if (tok) {
+        server_send(s, "error unexpected '%s'", tok);
+        return;
+    }
+    s->black = black;
+    s->white = white;
+    s->turn = turn;
+    server_send(s, "ok");
+}
 
-            // Aggregate root stats into shared arrays.
-            const ulong root_occ = (nodes[0].black | nodes[0].white);
-            for (uint8_t i = 0; i < nodes[0].child_count; i++) {
-                const uint32_t ci = nodes[0].children[i];
-                const ulong mv = (nodes[ci].black | nodes[ci].white) ^ root_occ;
-                int mi = -1;
-                for (int j = 0; j < root_moves_len; j++) {
-                    if (root_moves[j] == mv) { mi = j; break; }
-                }
-                if (mi >= 0) {
-                    #pragma omp atomic
-                    total_visits[mi] += (long long)nodes[ci].visits;
-                    #pragma omp atomic
-                    total_wins[mi] += (double)nodes[ci].wins;
-                }
+static void server_go(ServerSession *s, char **save) {
+    if (s->searching && __atomic_load_n(&s->done, __ATOMIC_ACQUIRE)) {
+        server_stop(s);
+    }
+    if (s->searching) {
+        server_send(s, "error busy");
+        return;
+    }
+    if (which_is_win(s->black, s->white) != 'n') {
+        server_send(s, "error game over");
+        return;
+    }
+    char engine = 0;
+    long long depth = -1, movetime = -1, iterations = -1;
+    bool infinite = false;
+    const char *tok;
+    while ((tok = strtok_r(NULL, " \t\r\n", save)) != NULL) {
+        const char *val = NULL;
+        if (strcmp(tok, "infinite") == 0) {
+            infinite = true;
+            continue;
+        }
+        if (strcmp(tok, "engine") != 0 && strcmp(tok, "depth") != 0 && strcmp(tok, "movetime") != 0
+            && strcmp(tok, "iterations") != 0) {
+            server_send(s, "error unknown go argument '%s'", tok);
+            return;
+        }
+        if ((val = strtok_r(NULL, " \t\r\n", save)) == NULL) {
+            server_send(s, "error missing value for '%s'", tok);
+            return;
+        }
+        if (strcmp(tok, "engine") == 0) {
+            if ((val[0] != 'm' && val[0] != 'c') || val[1] != '\0') {
+                server_send(s, "error engine must be 'm' or 'c'");
+                return;
             }
+            engine = val[0];
+        } else if (strcmp(tok, "depth") == 0) {
+            depth = strtoll(val, NULL, 10);
+        } else if (strcmp(tok, "movetime") == 0) {
+            movetime = strtoll(val, NULL, 10);
+        } else {
+            iterations = strtoll(val, NULL, 10);
+        }
+    }
+    if (engine == 0) engine = (iterations >= 0) ? 'c' : (depth >= 0) ? 'm' : s->cfg->engine;
+
+    // Any limit given replaces the server's defaults; `infinite` clears them all.
+    const bool limited = infinite || depth >= 0 || movetime >= 0 || iterations >= 0;
+    s->go_engine = engine;
+    s->go_minimax = s->cfg->minimax;
+    s->go_minimax.verbose = 0;
+    s->go_minimax.stop = &s->stop;
+    s->go_minimax.on_iteration = server_minimax_info;
+    s->go_minimax.on_iteration_arg = s;
+    s->go_mcts = s->cfg->mcts;
+    s->go_mcts.verbose = 0;
+    s->go_mcts.stop = &s->stop;
+    if (limited) {
+        s->go_minimax.depth = (depth > 0 && !infinite) ? (int)depth : 0;
+        s->go_minimax.time_ms = (movetime > 0 && !infinite) ? (int)movetime : 0;
+        s->go_mcts.iterations = (iterations > 0 && !infinite) ? iterations : 0;
+        s->go_mcts.time_ms = (movetime > 0 && !infinite) ? (int)movetime : 0;
+        s->go_mcts.game_time_ms = 0;
+    }
 
-            #pragma omp atomic
-            nodes_used_sum += (long long)node_count;
+    s->stop = 0;
+    s->done = 0;
+    if (pthread_create(&s->search_thread, NULL, server_search, s) != 0) {
+        server_send(s, "error could not start search");
+        return;
+    }
+    s->searching = true;
+}
 
-            free(nodes);
+// Serves one client until `quit` or end of input.
+static void server_session(const ServerConfig *cfg, FILE *in, int out_fd) {
+    ServerSession s;
+    memset(&s, 0, sizeof(s));
+    s.cfg = cfg;
+    s.out_fd = out_fd;
+    s.turn = 'b';
+    pthread_mutex_init(&s.out_lock, NULL);
+
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, in) >= 0) {
+        char *save = NULL;
+        const char *cmd = strtok_r(line, " \t\r\n", &save);
+        if (!cmd) continue;
+        if (strcmp(cmd, "quit") == 0) {
+            break;
+        } else if (strcmp(cmd, "isready") == 0) {
+            server_send(&s, "readyok");
+        } else if (strcmp(cmd, "stop") == 0) {
+            server_stop(&s);
+        } else if (strcmp(cmd, "newgame") == 0) {
+            server_stop(&s);
+            mcts_state_free(&s.mcts);
+            s.mcts.clock_used_ms = 0.0;
+            s.black = 0;
+            s.white = 0;
+            s.turn = 'b';
+            server_send(&s, "ok");
+        } else if (strcmp(cmd, "position") == 0) {
+            server_stop(&s);
+            server_position(&s, &save);
+        } else if (strcmp(cmd, "go") == 0) {
+            server_go(&s, &save);
+        } else {
+            server_send(&s, "error unknown command '%s'", cmd);
         }
     }
+    server_stop(&s);
+    mcts_state_free(&s.mcts);
+    free(line);
+    pthread_mutex_destroy(&s.out_lock);
+}
 
-    // Choose by max visits; tie-break by winrate.
-    int best_i = 0;
-    long long best_v = -1;
-    double best_wr = -1.0;
-    for (int i = 0; i < root_moves_len; i++) {
-        const long long v = total_visits[i];
-        const double wr = (v > 0) ? (total_wins[i] / (double)v) : 0.0;
-        if (v > best_v || (v == best_v && wr > best_wr)) {
-            best_v = v;
-            best_wr = wr;
-            best_i = i;
+typedef struct {
+    const ServerConfig *cfg;
+    int fds[SERVER_QUEUE];
+    int head;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} ServerQueue;
+
+static void *server_worker(void *arg) {
+    ServerQueue *q = (ServerQueue*)arg;
+    while (1) {
+        pthread_mutex_lock(&q->lock);
+        while (q->count == 0) pthread_cond_wait(&q->not_empty, &q->lock);
+        const int fd = q->fds[q->head];
+        q->head = (q->head + 1) % SERVER_QUEUE;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+        pthread_mutex_unlock(&q->lock);
+
+        const int in_fd = dup(fd);
+        FILE *in = (in_fd >= 0) ? fdopen(in_fd, "r") : NULL;
+        if (in) {
+            server_session(q->cfg, in, fd);
+            fclose(in);
+        } else if (in_fd >= 0) {
+            close(in_fd);
         }
+        close(fd);
     }
+    return NULL;
+}
 
-    if (cfg->verbose >= 1) {
-        const double elapsed_ms = (omp_get_wtime() - start) * 1000.0;
-        printf("mcts turn=%c sims=%lld time=%.1fms threads=%d C=%.6f rollout_depth=%d nodes_avg=%.0f\n",
-               my_turn, sims_done, elapsed_ms, threads, cfg->c, cfg->rollout_max_depth,
-               (threads > 0) ? ((double)nodes_used_sum / (double)threads) : 0.0);
-        for (int i = 0; i < root_moves_len; i++) {
-            const long long v = total_visits[i];
-            const double wr = (v > 0) ? (total_wins[i] / (double)v) : 0.0;
-            printf("  move=%2d visits=%8lld winrate=%.4f\n", binary2decimal(root_moves[i]), v, wr);
+// Accepts connections on a Unix socket and hands each to a pool of `threads` workers,
+// each serving one session at a time. Searches that do not set their thread count get
+// an equal share of the cores, so busy sessions do not oversubscribe the machine.
+// Only returns on error.
+static bool server_listen(const ServerConfig *cfg, const char *path, int threads) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path '%s' is too long.\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        fprintf(stderr, "Error: socket: %s\n", strerror(errno));
+        return false;
+    }
+    unlink(path);
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, SERVER_QUEUE) != 0) {
+        fprintf(stderr, "Error: could not listen on '%s': %s\n", path, strerror(errno));
+        close(listen_fd);
+        return false;
+    }
+    // A client that hangs up mid-reply must not kill the server.
+    signal(SIGPIPE, SIG_IGN);
+
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = (cores > 0) ? (int)cores : 1;
+    ServerConfig split = *cfg;
+    const int share = (cores > threads) ? (int)(cores / threads) : 1;
+    if (split.minimax.threads <= 0) split.minimax.threads = share;
+    if (split.mcts.threads <= 0) split.mcts.threads = share;
+    ServerQueue q = { .cfg = &split };
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_cond_init(&q.not_empty, NULL);
+    pthread_cond_init(&q.not_full, NULL);
+    for (int i = 0; i < threads; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, server_worker, &q) != 0) {
+            fprintf(stderr, "Error: could not start server thread %d.\n", i);
+            close(listen_fd);
+            return false;
+        }
+        pthread_detach(t);
+    }
+    printf("serve: listening on %s threads=%d search_threads=%d/%d\n", path, threads,
+           split.minimax.threads, split.mcts.threads);
+    fflush(stdout);
+
+    while (1) {
+        const int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            fprintf(stderr, "Error: accept: %s\n", strerror(errno));
+            break;
         }
+        pthread_mutex_lock(&q.lock);
+        while (q.count == SERVER_QUEUE) pthread_cond_wait(&q.not_full, &q.lock);
+        q.fds[(q.head + q.count) % SERVER_QUEUE] = fd;
+        q.count++;
+        pthread_cond_signal(&q.not_empty);
+        pthread_mutex_unlock(&q.lock);
     }
+    close(listen_fd);
+    return false;
+}
 
-    return root_moves[best_i];
+// ----------------------------
+// Perft (--perft N)
+// ----------------------------
+// Counts the positions exactly `depth` plies below the start. A won or drawn game ends
+// its branch: it is counted in wins/draws at the ply where it ends (and as a leaf if
+// that is the last ply). With `bulk`, the last ply is counted from the move mask
+// without playing it: the mover's open threats are the winning moves.
+typedef struct {
+    long long leaves;
+    long long wins;
+    long long draws;
+    long long nodes;           // moves played or bulk-counted, for nodes/sec
+} PerftCounts;
+
+static void perft_count(ulong black, ulong white, char turn, int depth, bool bulk, PerftCounts *c) {
+    const ulong legal = get_possible_pos_board(black, white);
+    if (bulk && depth == 1) {
+        const ulong own = (turn == 'b') ? black : white;
+        const ulong opp = (turn == 'b') ? white : black;
+        const int n = count_moves(legal);
+        const int wins = __builtin_popcountl(threat_cells(own, opp) & legal);
+        c->leaves += n;
+        c->wins += wins;
+        c->nodes += n;
+        if (__builtin_popcountl(black | white) == 63) c->draws += n - wins;
+        return;
+    }
+    ulong moves = legal;
+    while (moves) {
+        const ulong mv = first_move(moves);
+        moves ^= mv;
+        ulong nb = black, nw = white;
+        const char result = mcts_play(&nb, &nw, turn, mv);
+        c->nodes++;
+        if (depth == 1) c->leaves++;
+        if (result != 'n') {
+            if (result == 'd') c->draws++; else c->wins++;
+            continue;
+        }
+        if (depth > 1) perft_count(nb, nw, convert_turn(turn), depth - 1, bulk, c);
+    }
 }
 
-void game_start(char player1, char player2, bool enable_show_board, bool enable_show_result,
-                int depth1, int depth2, const MctsConfig *mcts1, const MctsConfig *mcts2, uint64_t rng_seed64) {
-    ulong black_board = 0;
-    ulong white_board = 0;
-    char now_player = player1;
-    char now_player_turn = 'b';
-    char result = 'n';
-    int player1_depth = depth1;
-    int player2_depth = depth2;
-    Rng game_rng;
-    rng_seed(&game_rng, rng_seed64);
+// Plays out the first `plies` plies into `frontier` (ongoing positions only), counting
+// the games that end on the way in *c. Returns the new frontier length.
+static int perft_frontier(ulong black, ulong white, char turn, int plies, ulong frontier[][2], int len,
+                          PerftCounts *c) {
+    if (plies == 0) {
+        frontier[len][0] = black;
+        frontier[len][1] = white;
+        return len + 1;
+    }
+    ulong moves = get_possible_pos_board(black, white);
+    while (moves) {
+        const ulong mv = first_move(moves);
+        moves ^= mv;
+        ulong nb = black, nw = white;
+        const char result = mcts_play(&nb, &nw, turn, mv);
+        c->nodes++;
+        if (result != 'n') {
+            if (result == 'd') c->draws++; else c->wins++;
+            continue;
+        }
+        len = perft_frontier(nb, nw, convert_turn(turn), plies - 1, frontier, len, c);
+    }
+    return len;
+}
 
-    while (result == 'n') {
-        unsigned long act = 0;
-        printf("turn: %c %c\n", now_player_turn, now_player);
-        if (now_player == 'h') {
-            act = human_act(black_board, white_board);
-        } else if (now_player == 'r') {
-            act = random_act(black_board, white_board, &game_rng);
-        } else if (now_player == 'm') {
-            if (now_player_turn == 'b') {
-                act = minmax_act(black_board, white_board, now_player_turn, player1_depth);
-            } else {
-                act = minmax_act(black_board, white_board, now_player_turn, player2_depth);
-            }
-        } else if (now_player == 'c') {
-            const MctsConfig *cfg = (now_player_turn == 'b') ? mcts1 : mcts2;
-            act = mcts_act(black_board, white_board, now_player_turn, cfg);
+// Multithreaded perft: the positions two plies down (256 from the empty board) are
+// shared out dynamically, so every thread has work even with many cores.
+static PerftCounts perft(ulong black, ulong white, char turn, int depth, bool bulk, int threads) {
+    PerftCounts total = {0};
+    if (depth <= 0) {
+        total.leaves = 1;
+        return total;
+    }
+    if (threads == 1 || depth <= 2) {
+        perft_count(black, white, turn, depth, bulk, &total);
+        return total;
+    }
+    ulong frontier[256][2];   // 16 x 16 positions two plies down
+    const int split = 2;
+    const int len = perft_frontier(black, white, turn, split, frontier, 0, &total);
+    const char frontier_turn = (split & 1) ? convert_turn(turn) : turn;
+    #pragma omp parallel num_threads(threads)
+    {
+        PerftCounts local = {0};
+        #pragma omp for schedule(dynamic, 1)
+        for (int i = 0; i < len; i++) {
+            perft_count(frontier[i][0], frontier[i][1], frontier_turn, depth - split, bulk, &local);
         }
+        #pragma omp atomic
+        total.leaves += local.leaves;
+        #pragma omp atomic
+        total.wins += local.wins;
+        #pragma omp atomic
+        total.draws += local.draws;
+        #pragma omp atomic
+        total.nodes += local.nodes;
+    }
+    return total;
+}
 
-        if (now_player_turn == 'b') {
-            printf("black put %d\n", binary2decimal(act));
-        } else if (now_player_turn == 'w') {
-            printf("white put %d\n", binary2decimal(act));
+// Runs perft at every depth from 1 to max_depth and prints the counts and nodes/sec.
+static void perft_run(ulong black, ulong white, char turn, int max_depth, bool bulk, int threads) {
+    if (threads <= 0) threads = omp_get_max_threads();
+    printf("perft: black=0x%016lx white=0x%016lx turn=%c bulk=%d threads=%d\n",
+           black, white, turn, bulk ? 1 : 0, threads);
+    for (int d = 1; d <= max_depth; d++) {
+        const double start = omp_get_wtime();
+        const PerftCounts c = perft(black, white, turn, d, bulk, threads);
+        const double elapsed = omp_get_wtime() - start;
+        printf("perft depth=%d leaves=%lld wins=%lld draws=%lld nodes=%lld time=%.1fms nps=%.0f\n",
+               d, c.leaves, c.wins, c.draws, c.nodes, elapsed * 1000.0,
+               (elapsed > 0.0) ? ((double)c.nodes / elapsed) : 0.0);
+        fflush(stdout);
+    }
+}
+
+// ----------------------------
+// Minimax benchmark (--minimax-bench D)
+// ----------------------------
+// Searches a fixed set of positions to depth D with one thread and with `threads`
+// threads (<= 0: all cores), each from an empty table, and prints nodes, nodes/sec and
+// the parallel speedup (one-thread time / N-thread time).
+static const char *const k_minimax_bench_positions[] = {
+    "",
+    "0,5,10,15",
+    "3,12,6,8,14,11",
+    "5,21,6,22,9,25,10",
+    "5,6,9,10,21,22,25,26,0,15",
+    "0,16,1,17,32,2,48,3,12,28",
+};
+
+static void minimax_bench(int depth, int threads) {
+    if (threads <= 0) threads = omp_get_max_threads();
+    const int run_threads[2] = {1, threads};
+    const int positions = (int)(sizeof(k_minimax_bench_positions) / sizeof(k_minimax_bench_positions[0]));
+    long long total_nodes[2] = {0, 0};
+    double total_s[2] = {0.0, 0.0};
+    printf("minimax bench: depth=%d threads=1/%d positions=%d tt=%zuMB\n", depth, threads, positions, g_tt.bytes >> 20);
+    for (int p = 0; p < positions; p++) {
+        ulong black = 0, white = 0;
+        char turn = 'b';
+        if (!parse_position(k_minimax_bench_positions[p], &black, &white, &turn)) {
+            fprintf(stderr, "bench: invalid position '%s'.\n", k_minimax_bench_positions[p]);
+            continue;
+        }
+        long long nodes[2];
+        double seconds[2];
+        for (int r = 0; r < 2; r++) {
+            tt_clear();
+            const MinimaxConfig cfg = { .depth = depth, .threads = run_threads[r], .nodes = &nodes[r] };
+            const double start = omp_get_wtime();
+            minmax_act(black, white, turn, &cfg);
+            seconds[r] = omp_get_wtime() - start;
+            total_nodes[r] += nodes[r];
+            total_s[r] += seconds[r];
         }
+        printf("bench pos=%d nodes=%lld/%lld time=%.1f/%.1fms nps=%.0f/%.0f speedup=%.2fx\n", p, nodes[0], nodes[1],
+               seconds[0] * 1000.0, seconds[1] * 1000.0, (double)nodes[0] / fmax(seconds[0], 1e-9),
+               (double)nodes[1] / fmax(seconds[1], 1e-9), seconds[0] / fmax(seconds[1], 1e-9));
+        fflush(stdout);
+    }
+    printf("bench total nodes=%lld/%lld time=%.1f/%.1fms nps=%.0f/%.0f speedup=%.2fx\n", total_nodes[0], total_nodes[1],
+           total_s[0] * 1000.0, total_s[1] * 1000.0, (double)total_nodes[0] / fmax(total_s[0], 1e-9),
+           (double)total_nodes[1] / fmax(total_s[1], 1e-9), total_s[0] / fmax(total_s[1], 1e-9));
+}
 
-        if (now_player_turn == 'b') {
-            black_board = black_board | act;
-        } else if (now_player_turn == 'w') {
-            white_board = white_board | act;
+// ----------------------------
+// Line kernel microbenchmark (--bench-kernels N)
+// ----------------------------
+static void bench_line_kernels(long long positions, uint64_t seed) {
+    ulong (*boards)[2] = (ulong (*)[2])malloc((size_t)positions * sizeof(*boards));
+    if (!boards) {
+        fprintf(stderr, "bench: OOM for %lld positions.\n", positions);
+        return;
+    }
+
+    // Random positions from random games, stopped at a uniformly random ply.
+    Rng rng;
+    rng_seed(&rng, seed);
+    for (long long p = 0; p < positions; p++) {
+        ulong black = 0;
+        ulong white = 0;
+        char turn = 'b';
+        const int plies = (int)rng_uniform_u32(&rng, 64);
+        for (int k = 0; k < plies && which_is_win_scalar(black, white) == 'n'; k++) {
+            const ulong mv = random_act(black, white, &rng);
+            if (turn == 'b') black |= mv; else white |= mv;
+            turn = convert_turn(turn);
         }
+        boards[p][0] = black;
+        boards[p][1] = white;
+    }
 
-        if (enable_show_board) {
-            print_board(black_board, white_board);
+    const int rounds = 10;
+    const LineKernels *avail[3];
+    const int n = available_line_kernels(avail);
+    double base_win = 0.0;
+    double base_diff = 0.0;
+    for (int k = 0; k < n; k++) {
+        const LineKernels *kern = avail[k];
+        long long mismatches = 0;
+        for (long long p = 0; p < positions; p++) {
+            if (kern->which_is_win(boards[p][0], boards[p][1]) != which_is_win_scalar(boards[p][0], boards[p][1])
+                || kern->line_diff(boards[p][0], boards[p][1]) != line_diff_scalar(boards[p][0], boards[p][1])) {
+                mismatches++;
+            }
         }
 
-        now_player_turn = convert_turn(now_player_turn);
-        if (now_player_turn == 'b') {
-            now_player = player1;
-        } else {
-            now_player = player2;
+        long long win_sum = 0;
+        long long diff_sum = 0;
+
+        double t0 = omp_get_wtime();
+        for (int r = 0; r < rounds; r++) {
+            for (long long p = 0; p < positions; p++) {
+                win_sum += kern->which_is_win(boards[p][0], boards[p][1]);
+            }
         }
+        const double win_s = omp_get_wtime() - t0;
 
-        result = which_is_win(black_board, white_board);
-    }
-    if (enable_show_result) {
-        if (result == 'w') {
-            printf("winner is white!\n");
-        } else if (result == 'b') {
-            printf("winner is black!\n");
-        } else {
-            printf("draw!\n");
+        t0 = omp_get_wtime();
+        for (int r = 0; r < rounds; r++) {
+            for (long long p = 0; p < positions; p++) {
+                diff_sum += kern->line_diff(boards[p][0], boards[p][1]);
+            }
+        }
+        const double diff_s = omp_get_wtime() - t0;
+
+        const double calls = (double)positions * (double)rounds;
+        const double win_rate = calls / win_s / 1e6;
+        const double diff_rate = calls / diff_s / 1e6;
+        if (k == 0) {
+            base_win = win_rate;
+            base_diff = diff_rate;
         }
+        printf("kernels=%-7s which_is_win=%7.1f Mpos/s (%.2fx)  line_diff=%7.1f Mpos/s (%.2fx)  mismatches=%lld  (checksum %lld)\n",
+               kern->name, win_rate, win_rate / base_win, diff_rate, diff_rate / base_diff,
+               mismatches, win_sum + diff_sum);
     }
+    printf("selected kernels: %s\n", g_line_kernels.name);
+    free(boards);
 }
 
 int main(int argc, char *argv[]) {
     char player1 = 'h';
     char player2 = 'h';
-    int depth1 = 0;
-    int depth2 = 0;
+    MinimaxConfig minimax_p1 = {
+        .depth = 0,
+        .time_ms = 0,
+        .threads = 0,
+        .verbose = 1,
+    };
+    MinimaxConfig minimax_p2 = minimax_p1;
     bool enable_show_board = true;
     bool enable_show_result = true;
     uint64_t program_seed = 0;
+    long long tt_mb = 64;
+    long long bench_kernels = 0;
+    int minimax_bench_depth = 0;
+    const char *solve_position_text = NULL;
+    int solve_time_ms = 0;
+    const char *book_path = NULL;
+    const char *book_build_path = NULL;
+    int book_ply = 4;
+    int book_depth = 8;
+    int perft_depth = 0;
+    const char *perft_position_text = "";
+    int perft_threads = 0;
+    bool perft_bulk = true;
+    int tournament_games = 0;
+    int tournament_workers = 0;
+    int tournament_random_plies = 2;
+    bool serve = false;
+    const char *serve_socket = NULL;
+    int serve_threads = 0;
+    bool enable_ponder = false;
 
     MctsConfig mcts_global = {
         .iterations = 20000,
@@ -939,6 +3591,11 @@ int main(int argc, char *argv[]) {
         .max_nodes = 0,
         .verbose = 1,
         .seed = 0,
+        .parallel = MCTS_PARALLEL_ROOT,
+        .reuse = 1,
+        .solver = 1,
+        .rave = 0,
+        .rave_k = 1000.0,
     };
     MctsConfig mcts_p1 = mcts_global;
     MctsConfig mcts_p2 = mcts_global;
@@ -954,10 +3611,39 @@ int main(int argc, char *argv[]) {
         OPT_MCTS_MAX_NODES,
         OPT_MCTS_VERBOSE,
         OPT_MCTS_SEED,
+        OPT_MCTS_PARALLEL,
+        OPT_MCTS_NO_REUSE,
+        OPT_MCTS_NO_SOLVER,
+        OPT_MCTS_RAVE,
+        OPT_MCTS_RAVE_K,
+        OPT_MCTS_GAME_TIME_MS,
         OPT_P1_MCTS_ITERATIONS,
         OPT_P2_MCTS_ITERATIONS,
         OPT_P1_MCTS_TIME_MS,
         OPT_P2_MCTS_TIME_MS,
+        OPT_TT_MB,
+        OPT_P1_TIME_MS,
+        OPT_P2_TIME_MS,
+        OPT_MINIMAX_THREADS,
+        OPT_BENCH_KERNELS,
+        OPT_MINIMAX_BENCH,
+        OPT_SOLVE,
+        OPT_SOLVE_TIME_MS,
+        OPT_BOOK,
+        OPT_BOOK_BUILD,
+        OPT_BOOK_PLY,
+        OPT_BOOK_DEPTH,
+        OPT_PERFT,
+        OPT_PERFT_POSITION,
+        OPT_PERFT_THREADS,
+        OPT_PERFT_NO_BULK,
+        OPT_TOURNAMENT,
+        OPT_TOURNAMENT_WORKERS,
+        OPT_TOURNAMENT_RANDOM_PLIES,
+        OPT_SERVE,
+        OPT_SERVE_SOCKET,
+        OPT_SERVE_THREADS,
+        OPT_PONDER,
     };
 
     struct option long_options[] = {
@@ -967,6 +3653,9 @@ int main(int argc, char *argv[]) {
         {"depth1", required_argument, NULL, 'd'},
         {"player2-depth", required_argument, NULL, 'D'},
         {"depth2", required_argument, NULL, 'D'},
+        {"player1-time-ms", required_argument, NULL, OPT_P1_TIME_MS},
+        {"player2-time-ms", required_argument, NULL, OPT_P2_TIME_MS},
+        {"minimax-threads", required_argument, NULL, OPT_MINIMAX_THREADS},
         {"no-board", no_argument, NULL, OPT_NO_BOARD},
         {"no-result", no_argument, NULL, OPT_NO_RESULT},
         {"mcts-iterations", required_argument, NULL, OPT_MCTS_ITERATIONS},
@@ -977,10 +3666,36 @@ int main(int argc, char *argv[]) {
         {"mcts-max-nodes", required_argument, NULL, OPT_MCTS_MAX_NODES},
         {"mcts-verbose", required_argument, NULL, OPT_MCTS_VERBOSE},
         {"mcts-seed", required_argument, NULL, OPT_MCTS_SEED},
+        {"mcts-parallel", required_argument, NULL, OPT_MCTS_PARALLEL},
+        {"mcts-no-reuse", no_argument, NULL, OPT_MCTS_NO_REUSE},
+        {"mcts-no-solver", no_argument, NULL, OPT_MCTS_NO_SOLVER},
+        {"mcts-rave", no_argument, NULL, OPT_MCTS_RAVE},
+        {"mcts-rave-k", required_argument, NULL, OPT_MCTS_RAVE_K},
+        {"mcts-game-time-ms", required_argument, NULL, OPT_MCTS_GAME_TIME_MS},
         {"player1-mcts-iterations", required_argument, NULL, OPT_P1_MCTS_ITERATIONS},
         {"player2-mcts-iterations", required_argument, NULL, OPT_P2_MCTS_ITERATIONS},
         {"player1-mcts-time-ms", required_argument, NULL, OPT_P1_MCTS_TIME_MS},
         {"player2-mcts-time-ms", required_argument, NULL, OPT_P2_MCTS_TIME_MS},
+        {"tt-mb", required_argument, NULL, OPT_TT_MB},
+        {"bench-kernels", required_argument, NULL, OPT_BENCH_KERNELS},
+        {"minimax-bench", required_argument, NULL, OPT_MINIMAX_BENCH},
+        {"solve", required_argument, NULL, OPT_SOLVE},
+        {"solve-time-ms", required_argument, NULL, OPT_SOLVE_TIME_MS},
+        {"book", required_argument, NULL, OPT_BOOK},
+        {"book-build", required_argument, NULL, OPT_BOOK_BUILD},
+        {"book-ply", required_argument, NULL, OPT_BOOK_PLY},
+        {"book-depth", required_argument, NULL, OPT_BOOK_DEPTH},
+        {"perft", required_argument, NULL, OPT_PERFT},
+        {"perft-position", required_argument, NULL, OPT_PERFT_POSITION},
+        {"perft-threads", required_argument, NULL, OPT_PERFT_THREADS},
+        {"perft-no-bulk", no_argument, NULL, OPT_PERFT_NO_BULK},
+        {"tournament", required_argument, NULL, OPT_TOURNAMENT},
+        {"tournament-workers", required_argument, NULL, OPT_TOURNAMENT_WORKERS},
+        {"tournament-random-plies", required_argument, NULL, OPT_TOURNAMENT_RANDOM_PLIES},
+        {"serve", no_argument, NULL, OPT_SERVE},
+        {"serve-socket", required_argument, NULL, OPT_SERVE_SOCKET},
+        {"serve-threads", required_argument, NULL, OPT_SERVE_THREADS},
+        {"ponder", no_argument, NULL, OPT_PONDER},
         {0, 0, 0, 0}
     };
 
@@ -1005,11 +3720,23 @@ int main(int argc, char *argv[]) {
                 }
                 break;
             case 'd':
-                depth1 = atoi(optarg);
+                minimax_p1.depth = atoi(optarg);
                 break;
             case 'D':
-                depth2 = atoi(optarg);
+                minimax_p2.depth = atoi(optarg);
+                break;
+            case OPT_P1_TIME_MS:
+                minimax_p1.time_ms = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_P2_TIME_MS:
+                minimax_p2.time_ms = (int)strtol(optarg, NULL, 10);
                 break;
+            case OPT_MINIMAX_THREADS: {
+                int v = (int)strtol(optarg, NULL, 10);
+                minimax_p1.threads = v;
+                minimax_p2.threads = v;
+                break;
+            }
             case OPT_NO_BOARD:
                 enable_show_board = false;
                 break;
@@ -1073,6 +3800,54 @@ int main(int argc, char *argv[]) {
                 program_seed = v;
                 break;
             }
+            case OPT_MCTS_PARALLEL: {
+                int v;
+                if (strcmp(optarg, "root") == 0) {
+                    v = MCTS_PARALLEL_ROOT;
+                } else if (strcmp(optarg, "tree") == 0) {
+                    v = MCTS_PARALLEL_TREE;
+                } else {
+                    fprintf(stderr, "Invalid --mcts-parallel mode. Use 'root' or 'tree'.\n");
+                    exit(EXIT_FAILURE);
+                }
+                mcts_global.parallel = v;
+                mcts_p1.parallel = v;
+                mcts_p2.parallel = v;
+                break;
+            }
+            case OPT_MCTS_NO_REUSE:
+                mcts_global.reuse = 0;
+                mcts_p1.reuse = 0;
+                mcts_p2.reuse = 0;
+                break;
+            case OPT_MCTS_NO_SOLVER:
+                mcts_global.solver = 0;
+                mcts_p1.solver = 0;
+                mcts_p2.solver = 0;
+                break;
+            case OPT_MCTS_RAVE:
+                mcts_global.rave = 1;
+                mcts_p1.rave = 1;
+                mcts_p2.rave = 1;
+                break;
+            case OPT_MCTS_RAVE_K: {
+                double v = strtod(optarg, NULL);
+                if (!(v > 0.0)) {
+                    fprintf(stderr, "--mcts-rave-k must be > 0\n");
+                    exit(EXIT_FAILURE);
+                }
+                mcts_global.rave_k = v;
+                mcts_p1.rave_k = v;
+                mcts_p2.rave_k = v;
+                break;
+            }
+            case OPT_MCTS_GAME_TIME_MS: {
+                int v = (int)strtol(optarg, NULL, 10);
+                mcts_global.game_time_ms = v;
+                mcts_p1.game_time_ms = v;
+                mcts_p2.game_time_ms = v;
+                break;
+            }
             case OPT_P1_MCTS_ITERATIONS:
                 mcts_p1.iterations = strtoll(optarg, NULL, 10);
                 break;
@@ -1085,23 +3860,83 @@ int main(int argc, char *argv[]) {
             case OPT_P2_MCTS_TIME_MS:
                 mcts_p2.time_ms = (int)strtol(optarg, NULL, 10);
                 break;
+            case OPT_TT_MB:
+                tt_mb = strtoll(optarg, NULL, 10);
+                break;
+            case OPT_BENCH_KERNELS:
+                bench_kernels = strtoll(optarg, NULL, 10);
+                break;
+            case OPT_MINIMAX_BENCH:
+                minimax_bench_depth = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_SOLVE:
+                solve_position_text = optarg;
+                break;
+            case OPT_SOLVE_TIME_MS:
+                solve_time_ms = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_BOOK:
+                book_path = optarg;
+                break;
+            case OPT_BOOK_BUILD:
+                book_build_path = optarg;
+                break;
+            case OPT_BOOK_PLY:
+                book_ply = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_BOOK_DEPTH:
+                book_depth = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_PERFT:
+                perft_depth = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_PERFT_POSITION:
+                perft_position_text = optarg;
+                break;
+            case OPT_PERFT_THREADS:
+                perft_threads = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_PERFT_NO_BULK:
+                perft_bulk = false;
+                break;
+            case OPT_TOURNAMENT:
+                tournament_games = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_TOURNAMENT_WORKERS:
+                tournament_workers = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_TOURNAMENT_RANDOM_PLIES:
+                tournament_random_plies = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_SERVE:
+                serve = true;
+                break;
+            case OPT_SERVE_SOCKET:
+                serve_socket = optarg;
+                break;
+            case OPT_SERVE_THREADS:
+                serve_threads = (int)strtol(optarg, NULL, 10);
+                break;
+            case OPT_PONDER:
+                enable_ponder = true;
+                break;
             default:
-                fprintf(stderr, "Usage: %s --player1 [h|m|c|r] --player2 [h|m|c|r] [--player1-depth N] [--player2-depth N] [--mcts-* ...]\n", argv[0]);
+                fprintf(stderr, "Usage: %s --player1 [h|m|c|r] --player2 [h|m|c|r] [--player1-depth N] [--player2-depth N] [--player1-time-ms MS] [--player2-time-ms MS] [--mcts-* ...]\n", argv[0]);
                 exit(EXIT_FAILURE);
         }
     }
 
-    if (player1 == 'm' && depth1 <= 0) {
-        fprintf(stderr, "Error: When using 'm' for player1, you must specify --player1-depth.\n");
+    if (player1 == 'm' && minimax_p1.depth <= 0 && minimax_p1.time_ms <= 0) {
+        fprintf(stderr, "Error: When using 'm' for player1, you must specify --player1-depth or --player1-time-ms.\n");
         exit(EXIT_FAILURE);
     }
-    if (player2 == 'm' && depth2 <= 0) {
-        fprintf(stderr, "Error: When using 'm' for player2, you must specify --player2-depth.\n");
+    if (player2 == 'm' && minimax_p2.depth <= 0 && minimax_p2.time_ms <= 0) {
+        fprintf(stderr, "Error: When using 'm' for player2, you must specify --player2-depth or --player2-time-ms.\n");
         exit(EXIT_FAILURE);
     }
-    if ((player1 == 'c' && mcts_p1.iterations <= 0 && mcts_p1.time_ms <= 0) ||
-        (player2 == 'c' && mcts_p2.iterations <= 0 && mcts_p2.time_ms <= 0)) {
-        fprintf(stderr, "Error: When using 'c' (MCTS) with --mcts-iterations <= 0, you must specify --mcts-time-ms (or per-player override).\n");
+    if ((player1 == 'c' && mcts_p1.iterations <= 0 && mcts_p1.time_ms <= 0 && mcts_p1.game_time_ms <= 0) ||
+        (player2 == 'c' && mcts_p2.iterations <= 0 && mcts_p2.time_ms <= 0 && mcts_p2.game_time_ms <= 0)) {
+        fprintf(stderr, "Error: When using 'c' (MCTS) with --mcts-iterations <= 0, you must specify --mcts-time-ms or --mcts-game-time-ms (or per-player override).\n");
         exit(EXIT_FAILURE);
     }
     if (mcts_p1.rollout_max_depth <= 0) mcts_p1.rollout_max_depth = 64;
@@ -1109,14 +3944,88 @@ int main(int argc, char *argv[]) {
     if (mcts_p1.c <= 0.0) mcts_p1.c = 1.41421356237;
     if (mcts_p2.c <= 0.0) mcts_p2.c = 1.41421356237;
 
-    init_cell_lines();
+    board_init();
+    if (solve_position_text) {
+        ulong black = 0, white = 0;
+        char turn = 'b';
+        if (!parse_position(solve_position_text, &black, &white, &turn)) {
+            fprintf(stderr, "Error: invalid --solve position '%s'. Use cell indices in play order (e.g. 0,16,5) or BLACK:WHITE bitboards.\n",
+                    solve_position_text);
+            exit(EXIT_FAILURE);
+        }
+        return solve_position(black, white, turn, tt_mb, solve_time_ms, enable_show_board) ? 0 : 2;
+    }
+    if (perft_depth > 0) {
+        ulong black = 0, white = 0;
+        char turn = 'b';
+        if (!parse_position(perft_position_text, &black, &white, &turn)) {
+            fprintf(stderr, "Error: invalid --perft-position '%s'.\n", perft_position_text);
+            exit(EXIT_FAILURE);
+        }
+        perft_run(black, white, turn, perft_depth, perft_bulk, perft_threads);
+        return 0;
+    }
+    if (!tt_init(tt_mb)) {
+        fprintf(stderr, "Error: could not allocate a %lldMB transposition table.\n", tt_mb);
+        exit(EXIT_FAILURE);
+    }
     if (program_seed == 0) {
         program_seed = (mcts_global.seed != 0) ? mcts_global.seed : auto_seed64();
     }
 
+    if (bench_kernels > 0) {
+        bench_line_kernels(bench_kernels, program_seed);
+        return 0;
+    }
+    if (minimax_bench_depth > 0) {
+        minimax_bench(minimax_bench_depth, minimax_p1.threads);
+        return 0;
+    }
+    if (book_build_path) {
+        return book_build(book_build_path, book_ply, book_depth, minimax_p1.threads) ? 0 : EXIT_FAILURE;
+    }
+    if (book_path && !book_open(book_path)) {
+        fprintf(stderr, "Error: could not load opening book '%s'.\n", book_path);
+        exit(EXIT_FAILURE);
+    }
+    if (serve || serve_socket) {
+        // The player1 settings are the defaults for `go`.
+        const ServerConfig server = {
+            .engine = (player1 == 'm') ? 'm' : 'c',
+            .minimax = minimax_p1,
+            .mcts = mcts_p1,
+        };
+        if (serve_socket) {
+            return server_listen(&server, serve_socket, serve_threads) ? 0 : EXIT_FAILURE;
+        }
+        server_session(&server, stdin, STDOUT_FILENO);
+        return 0;
+    }
+    if (tournament_games > 0) {
+        if (player1 == 'h' || player2 == 'h') {
+            fprintf(stderr, "Error: --tournament needs two engine players ('m', 'c' or 'r').\n");
+            exit(EXIT_FAILURE);
+        }
+        // Games already run one per core, so each search defaults to a single thread.
+        TournamentPlayer a = { .type = player1, .minimax = minimax_p1, .mcts = mcts_p1 };
+        TournamentPlayer b = { .type = player2, .minimax = minimax_p2, .mcts = mcts_p2 };
+        TournamentPlayer *both[2] = { &a, &b };
+        for (int i = 0; i < 2; i++) {
+            both[i]->minimax.verbose = 0;
+            both[i]->mcts.verbose = 0;
+            if (both[i]->minimax.threads <= 0) both[i]->minimax.threads = 1;
+            if (both[i]->mcts.threads <= 0) both[i]->mcts.threads = 1;
+        }
+        if (tournament_random_plies < 0) tournament_random_plies = 0;
+        return tournament_run(&a, &b, tournament_games, tournament_workers, tournament_random_plies,
+                              program_seed) ? 0 : EXIT_FAILURE;
+    }
+
     printf("player1: %c\n", player1);
     printf("player2: %c\n", player2);
-    printf("player1-depth: %d\n", depth1);
-    printf("player2-depth: %d\n", depth2);
-    game_start(player1, player2, enable_show_board, enable_show_result, depth1, depth2, &mcts_p1, &mcts_p2, program_seed ^ UINT64_C(0x243f6a8885a308d3));
+    printf("player1-depth: %d\n", minimax_p1.depth);
+    printf("player2-depth: %d\n", minimax_p2.depth);
+    if (minimax_p1.time_ms > 0) printf("player1-time-ms: %d\n", minimax_p1.time_ms);
+    if (minimax_p2.time_ms > 0) printf("player2-time-ms: %d\n", minimax_p2.time_ms);
+    game_start(player1, player2, enable_show_board, enable_show_result, enable_ponder, &minimax_p1, &minimax_p2, &mcts_p1, &mcts_p2, program_seed ^ UINT64_C(0x243f6a8885a308d3));
 }